@@ -0,0 +1,419 @@
+/**
+ * Logger is an asynchronous sink for log messages.
+ *
+ * Callers enqueue messages onto a bounded multi-producer ring without
+ * taking a lock. A background writer thread drains the ring and writes
+ * each batch of messages with a single write(2) call, so logging never
+ * flushes a stream on the caller's thread.
+ *
+ * Messages can be rate limited per call site: with a nonzero rateLimit,
+ * after rateLimit messages from one site within a second, further messages
+ * from that site are counted instead of queued, and the count is reported
+ * in a summary message when the site logs again in a later second or when
+ * the logger is flushed. There is no limit by default.
+ *
+ * The output is either text, one message per line, or binary records
+ * of the form
+ *
+ *     U64 time (nanoseconds since the epoch)
+ *     U32 level
+ *     U32 length
+ *     char text[length]
+ *
+ * in host byte order.
+ */
+
+#ifndef FWK_LOGGER_H
+#define FWK_LOGGER_H
+
+class Logger {
+public:
+
+    enum Format {
+        text,
+        binary
+    };
+
+    /** Source of message times, in nanoseconds since the epoch. */
+    typedef U64 (*Clock)();
+
+
+    /**
+     * Return the process-wide logger, starting its writer thread on first use.
+     */
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+
+    /** Output format. */
+    Format format() const {
+        return format_.load(std::memory_order_relaxed);
+    }
+
+    /** Modify the output format. */
+    void formatIs(const Format format) {
+        format_.store(format, std::memory_order_relaxed);
+    }
+
+
+    /** File descriptor the writer thread writes to, stderr by default. */
+    int fd() const {
+        return fd_.load(std::memory_order_relaxed);
+    }
+
+    /** Modify the file descriptor the writer thread writes to. */
+    void fdIs(const int fd) {
+        flush();
+        fd_.store(fd, std::memory_order_relaxed);
+    }
+
+
+    /** Messages allowed per call site per second, or 0 (the default) for no limit. */
+    U32 rateLimit() const {
+        return rateLimit_.load(std::memory_order_relaxed);
+    }
+
+    /** Modify the messages allowed per call site per second. */
+    void rateLimitIs(const U32 rateLimit) {
+        rateLimit_.store(rateLimit, std::memory_order_relaxed);
+    }
+
+
+    /** Clock giving message times and rate-limiting seconds. */
+    Clock clock() const {
+        return clock_.load(std::memory_order_relaxed);
+    }
+
+    /** Modify the clock, normally to a fake one in tests. */
+    void clockIs(const Clock clock) {
+        clock_.store(clock != null ? clock : &wallNs, std::memory_order_relaxed);
+    }
+
+
+    /** Total number of messages suppressed by rate limiting. */
+    U64 suppressedCount() const {
+        return suppressedCount_.load(std::memory_order_relaxed);
+    }
+
+
+    /**
+     * Queue a message from the given call site. The text is the prefix
+     * followed by the message; the two are joined in the queue slot
+     * so a rate-limited message is never built. The prefix must outlive
+     * the logger, normally a string literal.
+     */
+    void messageNew(
+        const void* const site, const U32 level,
+        const char* const prefix, const string& message
+    ) {
+        const auto now = clock()();
+
+        auto& s = this->site(site);
+        s.level.store(level, std::memory_order_relaxed);
+        s.prefix.store(prefix, std::memory_order_relaxed);
+
+        const auto suppressed = admitted(s, now / nsPerSecond);
+        if (suppressed == notAdmitted) {
+            return;
+        }
+
+        if (suppressed != 0) {
+            enqueue(level, now, prefix, summary(suppressed));
+        }
+
+        enqueue(level, now, prefix, message);
+    }
+
+    /**
+     * Report pending suppressed counts and wait until every message queued
+     * so far has been written.
+     */
+    _noinline
+    void flush() {
+        const auto now = clock()();
+        for (auto& s : sites_) {
+            const auto suppressed = s.suppressed.exchange(0);
+            if (suppressed != 0) {
+                enqueue(
+                    s.level.load(std::memory_order_relaxed), now,
+                    s.prefix.load(std::memory_order_relaxed), summary(suppressed)
+                );
+            }
+        }
+
+        const auto target = tail_.load(std::memory_order_acquire);
+        while (written_.load(std::memory_order_acquire) < target) {
+            std::this_thread::yield();
+        }
+    }
+
+
+    Logger(const Logger&) = delete;
+
+    void operator =(const Logger&) = delete;
+
+private:
+
+    static const U64 slotCount = 1 << 12;
+
+    static const U64 siteCount = 1 << 10;
+
+    static const U64 nsPerSecond = 1000000000;
+
+    static const size_t batchSize = 1 << 16;
+
+    static const U32 notAdmitted = ~U32(0);
+
+
+    struct Slot {
+        std::atomic<U64> sequence;
+        U32 level;
+        U64 time;
+        string text;
+    };
+
+    /** Rate-limiting state for one call site. */
+    struct Site {
+        std::atomic<uintptr_t> key;
+        std::atomic<U32> level;
+        std::atomic<const char*> prefix;
+        std::atomic<U64> second;
+        std::atomic<U32> count;
+        std::atomic<U32> suppressed;
+    };
+
+
+    std::atomic<Format> format_;
+    std::atomic<int> fd_;
+    std::atomic<U32> rateLimit_;
+    std::atomic<Clock> clock_;
+    std::atomic<U64> suppressedCount_;
+
+    std::vector<Slot> slots_;
+    std::vector<Site> sites_;
+
+    std::atomic<U64> tail_;
+    std::atomic<U64> written_;
+    std::atomic<bool> stopped_;
+
+    std::thread writer_;
+
+
+    Logger() :
+        format_(text),
+        fd_(2),
+        rateLimit_(0),
+        clock_(&wallNs),
+        suppressedCount_(0),
+        slots_(slotCount),
+        sites_(siteCount),
+        tail_(0),
+        written_(0),
+        stopped_(false)
+    {
+        for (U64 i = 0; i < slotCount; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        for (auto& s : sites_) {
+            s.key.store(0, std::memory_order_relaxed);
+            s.level.store(0, std::memory_order_relaxed);
+            s.prefix.store("", std::memory_order_relaxed);
+            s.second.store(0, std::memory_order_relaxed);
+            s.count.store(0, std::memory_order_relaxed);
+            s.suppressed.store(0, std::memory_order_relaxed);
+        }
+
+        writer_ = std::thread([this]() { writeAll(); });
+    }
+
+    ~Logger() {
+        flush();
+
+        stopped_.store(true, std::memory_order_release);
+        writer_.join();
+    }
+
+
+    static U64 wallNs() {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(
+            system_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    static string summary(const U32 suppressed) {
+        return std::to_string(suppressed) + " similar messages suppressed";
+    }
+
+
+    /**
+     * Find or claim the rate-limiting entry for a call site. If the table
+     * is full, the site shares the entry it hashed to.
+     */
+    Site& site(const void* const site) {
+        const auto key = uintptr_t(site) + 1;
+        const auto start = (key >> 2) * 0x9e3779b97f4a7c15ull % siteCount;
+
+        for (U64 i = 0; i < siteCount; ++i) {
+            auto& s = sites_[(start + i) % siteCount];
+
+            auto k = s.key.load(std::memory_order_acquire);
+            if (k == 0 && s.key.compare_exchange_strong(k, key)) {
+                return s;
+            }
+
+            if (k == key) {
+                return s;
+            }
+        }
+
+        return sites_[start];
+    }
+
+    /**
+     * Count a message against its site's limit for the current second.
+     * Returns notAdmitted if the message should be dropped, otherwise
+     * the number of messages suppressed in an earlier second (normally 0).
+     */
+    U32 admitted(Site& s, const U64 second) {
+        const auto limit = rateLimit_.load(std::memory_order_relaxed);
+        if (limit == 0) {
+            return 0;
+        }
+
+        U32 suppressed = 0;
+
+        auto current = s.second.load(std::memory_order_relaxed);
+        if (current != second &&
+            s.second.compare_exchange_strong(current, second)
+        ) {
+            s.count.store(0, std::memory_order_relaxed);
+            suppressed = s.suppressed.exchange(0);
+        }
+
+        if (s.count.fetch_add(1, std::memory_order_relaxed) < limit) {
+            return suppressed;
+        }
+
+        s.suppressed.fetch_add(1, std::memory_order_relaxed);
+        suppressedCount_.fetch_add(1, std::memory_order_relaxed);
+
+        return notAdmitted;
+    }
+
+    /**
+     * Claim a slot at the tail of the ring, yielding while the ring
+     * is full, and publish the message in it.
+     */
+    void enqueue(
+        const U32 level, const U64 time,
+        const char* const prefix, const string& message
+    ) {
+        auto pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& slot = slots_[pos % slotCount];
+            const auto sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = S64(sequence - pos);
+
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                std::this_thread::yield();
+                pos = tail_.load(std::memory_order_relaxed);
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+
+        auto& slot = slots_[pos % slotCount];
+        slot.level = level;
+        slot.time = time;
+        slot.text.assign(prefix);
+        slot.text.append(message);
+
+        slot.sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    /**
+     * Writer thread: drain the ring into a batch buffer and write each
+     * batch with one system call, sleeping briefly when the ring is empty.
+     */
+    void writeAll() {
+        string batch;
+        batch.reserve(batchSize);
+
+        U64 head = 0;
+        for (;;) {
+            U64 n = 0;
+            while (batch.size() < batchSize) {
+                auto& slot = slots_[head % slotCount];
+                if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+                    break;
+                }
+
+                append(batch, slot);
+
+                slot.sequence.store(head + slotCount, std::memory_order_release);
+                ++head;
+                ++n;
+            }
+
+            if (n != 0) {
+                write(batch);
+                batch.clear();
+
+                written_.store(head, std::memory_order_release);
+            } else if (stopped_.load(std::memory_order_acquire)) {
+                break;
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+    }
+
+    void append(string& batch, const Slot& slot) {
+        if (format() == binary) {
+            const U32 length = U32(slot.text.size());
+
+            char header[sizeof(U64) + 2 * sizeof(U32)];
+            memcpy(header, &slot.time, sizeof(U64));
+            memcpy(header + sizeof(U64), &slot.level, sizeof(U32));
+            memcpy(header + sizeof(U64) + sizeof(U32), &length, sizeof(U32));
+
+            batch.append(header, sizeof(header));
+            batch.append(slot.text);
+        } else {
+            batch.append(slot.text);
+            batch.push_back('\n');
+        }
+    }
+
+    void write(const string& batch) {
+        const auto fd = this->fd();
+
+        const char* p = batch.data();
+        size_t remaining = batch.size();
+        while (remaining > 0) {
+            const auto n = ::write(fd, p, remaining);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                // Nowhere left to report the failure; drop the batch.
+                return;
+            }
+
+            p += n;
+            remaining -= size_t(n);
+        }
+    }
+
+};
+
+#endif
@@ -5,42 +5,66 @@
 #ifndef FWK_NOMINAL_H
 #define FWK_NOMINAL_H
 
+/**
+ * Equality policy comparing representation values exactly.
+ */
+class ExactEquality {
+public:
+
+    template <class RepType>
+    static constexpr bool equal(const RepType v1, const RepType v2) {
+        return v1 == v2;
+    }
+
+};
+
+/**
+ * Equality policy treating values that differ by less than a builtin
+ * tolerance as equal.
+ */
+class TolerantEquality {
+public:
+
+    static constexpr double tolerance = 1e-4;
+
+
+    template <class RepType>
+    static constexpr bool equal(const RepType v1, const RepType v2) {
+        return v1 < v2 + tolerance && v1 > v2 - tolerance;
+    }
+
+};
+
+
 /**
  * Nominal only defines equality, inequality, assignment, and conversion
  * to and from the representation type.
+ *
+ * Nominal has no virtual functions and uses the implicit copy operations,
+ * so a value is exactly the size of its representation and is trivially
+ * copyable. The Equality policy decides how values compare.
  */
-template <class UnitType, class RepType>
+template <class UnitType, class RepType, class Equality = ExactEquality>
 class Nominal {
 public:
 
-    Nominal(const RepType v) :
+    constexpr Nominal(const RepType v) :
         value_(v)
     {
         // Nothing else to do.
     }
 
-    Nominal(const Nominal& n) :
-        value_(n.value_)
-    {
-        // Nothing else to do.
-    }
 
-
-    void operator =(const Nominal& v) {
-        value_ = v.value_;
+    constexpr bool operator ==(const Nominal& v) const {
+        return Equality::equal(value_, v.value_);
     }
 
-
-    virtual bool operator ==(const Nominal& v) const {
-        return value_ == v.value_;
-    }
-	
-    virtual bool operator !=(const Nominal& v) const {
-        return value_ != v.value_;
+    constexpr bool operator !=(const Nominal& v) const {
+        return !Equality::equal(value_, v.value_);
     }
 
 
-    RepType value() const {
+    constexpr RepType value() const {
         return value_;
     }
 
@@ -16,12 +16,15 @@ namespace NotifierLib {
             const auto& a = n->activity();
             if (a == null || a->immediateDeliveryFlag()) {
                 try {
+                    Tracer::Span span(notifier, func);
                     (n->*func)();
                 } catch (...) {
                     n->onNotificationException();
                 }
             } else {
-                a->postingNew(n, [=]() { (n->*func)(); });
+                a->postingNew(
+                    n, Tracer::reaction(notifier, func, [=]() { (n->*func)(); })
+                );
             }
         }
     }
@@ -36,12 +39,15 @@ namespace NotifierLib {
             const auto& a = n->activity();
             if (a == null || a->immediateDeliveryFlag()) {
                 try {
+                    Tracer::Span span(notifier, func);
                     (n->*func)(a1);
                 } catch (...) {
                     n->onNotificationException();
                 }
             } else {
-                a->postingNew(n, [=]() { (n->*func)(a1); });
+                a->postingNew(
+                    n, Tracer::reaction(notifier, func, [=]() { (n->*func)(a1); })
+                );
             }
         }
     }
@@ -56,12 +62,15 @@ namespace NotifierLib {
             const auto& a = n->activity();
             if (a == null || a->immediateDeliveryFlag()) {
                 try {
+                    Tracer::Span span(notifier, func);
                     (n->*func)(a1);
                 } catch (...) {
                     n->onNotificationException();
                 }
             } else {
-                a->postingNew(n, [=]() { (n->*func)(a1); });
+                a->postingNew(
+                    n, Tracer::reaction(notifier, func, [=]() { (n->*func)(a1); })
+                );
             }
         }
     }
@@ -9,58 +9,47 @@
  * Ordinal adds ordering comparisons, addition/subtraction,
  * multiplication/division, and increment/decrement operators.
  */
-template <class UnitType, class RepType>
-class Ordinal : public Nominal<UnitType, RepType> {
+template <class UnitType, class RepType, class Equality = ExactEquality>
+class Ordinal : public Nominal<UnitType, RepType, Equality> {
 public:
 
-    Ordinal(const RepType v) :
-        Nominal<UnitType, RepType>(v)
+    constexpr Ordinal(const RepType v) :
+        Nominal<UnitType, RepType, Equality>(v)
     {
         // Nothing else to do.
     }
 
-    Ordinal(const Ordinal& ordinal) :
-        Nominal<UnitType, RepType>(ordinal.value_)
-    {
-        // Nothing else to do.
-    }
-
-
-    void operator =(const Ordinal& ordinal) {
-        this->value_ = ordinal.value_;
-    }
-
 
-    bool operator <(const Ordinal& v) const {
-        return Nominal<UnitType, RepType>::value_ < v.value_;
+    constexpr bool operator <(const Ordinal& v) const {
+        return this->value_ < v.value_;
     }
 
-    bool operator <=(const Ordinal& v) const {
-        return Nominal<UnitType, RepType>::value_ <= v.value_;
+    constexpr bool operator <=(const Ordinal& v) const {
+        return this->value_ <= v.value_;
     }
 
-    bool operator >(const Ordinal& v) const {
-        return Nominal<UnitType, RepType>::value_ > v.value_;
+    constexpr bool operator >(const Ordinal& v) const {
+        return this->value_ > v.value_;
     }
 
-    bool operator >=(const Ordinal& v) const {
+    constexpr bool operator >=(const Ordinal& v) const {
         return this->value_ >= v.value_;
     }
 
 
-    Ordinal operator +(const Ordinal& other) const {
+    constexpr Ordinal operator +(const Ordinal& other) const {
         return this->value_ + other.value_;
     }
 
-    Ordinal operator -(const Ordinal& other) const {
+    constexpr Ordinal operator -(const Ordinal& other) const {
         return this->value_ - other.value_;
     }
 
-    Ordinal operator /(const Ordinal& other) const {
+    constexpr Ordinal operator /(const Ordinal& other) const {
         return this->value_ / other.value_;
     }
 
-    Ordinal operator *(const Ordinal& other) const {
+    constexpr Ordinal operator *(const Ordinal& other) const {
         return this->value_ * other.value_;
     }
 
@@ -0,0 +1,65 @@
+/**
+ * Result template type for operations that can fail without throwing.
+ */
+
+#ifndef FWK_RESULT_H
+#define FWK_RESULT_H
+
+/**
+ * Result holds either a value or the reason no value could be produced.
+ * It lets code on hot paths, such as parsing client strings, reject bad
+ * input with a branch instead of an exception unwind.
+ *
+ * The error is a static message, so making or testing a Result never
+ * allocates. The value is only meaningful when ok() is true.
+ */
+template <class T>
+class Result {
+public:
+
+    /** Successful result holding the given value. */
+    constexpr Result(const T& value) :
+        value_(value),
+        error_(null)
+    {
+        // Nothing else to do.
+    }
+
+    /** Failed result with the given static error message. */
+    static constexpr Result errorNew(const char* const error) {
+        return Result(error);
+    }
+
+
+    /** Flag indicating whether the result holds a value. */
+    constexpr bool ok() const {
+        return error_ == null;
+    }
+
+    /** Value of a successful result. */
+    constexpr T value() const {
+        return value_;
+    }
+
+    /** Error message of a failed result, or null if it succeeded. */
+    constexpr const char* error() const {
+        return error_;
+    }
+
+private:
+
+    T value_;
+
+    const char* error_;
+
+
+    constexpr explicit Result(const char* const error) :
+        value_(),
+        error_(error)
+    {
+        // Nothing else to do.
+    }
+
+};
+
+#endif
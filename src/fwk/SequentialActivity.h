@@ -184,6 +184,8 @@ protected:
     }
 
     void tryDeliver(const Posting& posting) {
+        Tracer::Span span(name(), "Activity::deliverOne");
+
         try {
             posting.reaction();
         } catch (const std::exception& e) {
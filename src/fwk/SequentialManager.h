@@ -51,7 +51,12 @@ public:
 
     _noinline
     void activityAdd(const Ptr<Activity>& activity) {
-	scheduledActivities_.push(activity);
+        Scheduled scheduled;
+        scheduled.ticks = activity->nextTime().ticks();
+        scheduled.sequence = ++sequence_;
+        scheduled.activity = activity;
+
+	scheduledActivities_.push(scheduled);
     }
 
 
@@ -66,18 +71,18 @@ public:
     _noinline
     void nowIs(const Time& t) {
 	while (!scheduledActivities_.empty()) {
-	    const auto& nextToRun = scheduledActivities_.top();
-
-            const auto nextTimeToRun = nextToRun->nextTime();
-	    if (nextTimeToRun > t) {
+	    const auto& next = scheduledActivities_.top();
+	    if (next.ticks > t.ticks()) {
                 // Finished running everything before or at time t.
 		break;
 	    }
 
-	    now_ = nextTimeToRun;
+	    now_ = Time::fromTicks(next.ticks);
 
+	    const auto nextToRun = next.activity;
 	    scheduledActivities_.pop();
 
+            Tracer::Span span(nextToRun->name(), "ActivityManager::nowIs");
 	    nextToRun->statusIs(Activity::running);
 	}
 
@@ -93,33 +98,46 @@ protected:
     typedef std::unordered_map< string, Ptr<Activity> > ActivityMap;
 
 
-    typedef std::vector< Ptr<Activity> > Container;
+    /**
+     * Queue entry for a scheduled activity. The time is captured in ticks
+     * when the activity is added, so each heap comparison is an integer
+     * compare, and the sequence number orders activities scheduled for
+     * the same time by when they were added.
+     */
+    struct Scheduled {
+        S64 ticks;
+        U64 sequence;
+        Ptr<Activity> activity;
+    };
+
+    typedef std::vector<Scheduled> Container;
 
-    class Cmp : public std::binary_function<Ptr<Activity>, Ptr<Activity>, bool> {
+    class Cmp {
     public:
 
-        Cmp() {
-            // Nothing to do.
-        }
-
+        bool operator()(const Scheduled& s1, const Scheduled& s2) const {
+            if (s1.ticks != s2.ticks) {
+                return s1.ticks > s2.ticks;
+            }
 
-        bool operator()(const Ptr<Activity>& a1, const Ptr<Activity>& a2) const {
-            return a1->nextTime() > a2->nextTime();
+            return s1.sequence > s2.sequence;
         }
 
     };
 
-    typedef std::priority_queue<Ptr<Activity>, Container, Cmp> ActivityQueue;
+    typedef std::priority_queue<Scheduled, Container, Cmp> ActivityQueue;
 
 protected:
 
     Time now_;
+    U64 sequence_;
     ActivityMap activities_;
     ActivityQueue scheduledActivities_;
 
 
     SequentialManager() :
-        now_(0.0)
+        now_(0.0),
+        sequence_(0)
     {
         // Nothing else to do.
     }
@@ -0,0 +1,121 @@
+/**
+ * Time value type for simulated time.
+ */
+
+#ifndef FWK_TIME_H
+#define FWK_TIME_H
+
+/**
+ * Time is a point or a duration in simulated time, represented as a signed
+ * count of nanosecond ticks. Arithmetic and comparisons are exact integer
+ * operations, so two events at the same time always compare equal and
+ * ordering does not depend on floating-point rounding.
+ *
+ * Seconds as a double are accepted and returned only at the API edge:
+ * the implicit conversion from double rounds to the nearest tick, and
+ * value() converts back to seconds. Ticks cover about +/-292 years;
+ * seconds beyond that, including infinities, are clamped to the first
+ * or last tick, and NaN is rejected with a RangeException.
+ */
+class Time {
+public:
+
+    /** Number of ticks in one second. */
+    static constexpr S64 ticksPerSecond = 1000000000;
+
+
+    /**
+     * Conversion from a number of seconds, rounded to the nearest tick
+     * and clamped to the range of ticks. Throws RangeException for NaN.
+     */
+    constexpr Time(const double seconds = 0) :
+        ticks_(roundedTicks(seconds * ticksPerSecond))
+    {
+        // Nothing else to do.
+    }
+
+    /** Return the time that is the given number of ticks. */
+    static constexpr Time fromTicks(const S64 ticks) {
+        return Time(ticks, TicksTag());
+    }
+
+
+    /** Number of ticks. */
+    constexpr S64 ticks() const {
+        return ticks_;
+    }
+
+    /** Number of seconds, for display and other API edges. */
+    constexpr double value() const {
+        return double(ticks_) / ticksPerSecond;
+    }
+
+
+    constexpr bool operator ==(const Time t) const {
+        return ticks_ == t.ticks_;
+    }
+
+    constexpr bool operator !=(const Time t) const {
+        return ticks_ != t.ticks_;
+    }
+
+    constexpr bool operator <(const Time t) const {
+        return ticks_ < t.ticks_;
+    }
+
+    constexpr bool operator <=(const Time t) const {
+        return ticks_ <= t.ticks_;
+    }
+
+    constexpr bool operator >(const Time t) const {
+        return ticks_ > t.ticks_;
+    }
+
+    constexpr bool operator >=(const Time t) const {
+        return ticks_ >= t.ticks_;
+    }
+
+
+    constexpr Time operator +(const Time t) const {
+        return fromTicks(ticks_ + t.ticks_);
+    }
+
+    constexpr Time operator -(const Time t) const {
+        return fromTicks(ticks_ - t.ticks_);
+    }
+
+    void operator +=(const Time t) {
+        ticks_ += t.ticks_;
+    }
+
+    void operator -=(const Time t) {
+        ticks_ -= t.ticks_;
+    }
+
+private:
+
+    struct TicksTag { };
+
+
+    S64 ticks_;
+
+
+    constexpr Time(const S64 ticks, TicksTag) :
+        ticks_(ticks)
+    {
+        // Nothing else to do.
+    }
+
+    /** 2^63 as a double: the first value too large for an S64. */
+    static constexpr double ticksLimit = 9223372036854775808.0;
+
+    static constexpr S64 roundedTicks(const double ticks) {
+        return ticks != ticks ? throw RangeException("Time is not a number") :
+            ticks >= ticksLimit ? S64(0x7fffffffffffffffll) :
+            ticks <= -ticksLimit ? -S64(0x7fffffffffffffffll) - 1 :
+            ticks < 0 ? S64(ticks - 0.5) : S64(ticks + 0.5);
+    }
+
+};
+
+#endif
@@ -0,0 +1,400 @@
+/**
+ * Tracer records execution spans for notification delivery and activity
+ * scheduling and writes them in the Chrome trace-event format, which
+ * chrome://tracing and Perfetto can load.
+ *
+ * Tracing is off by default. When it is off, a Span costs a single test
+ * of the enabled flag. When it is on, each thread appends completed spans
+ * to its own fixed-size ring buffer without taking a lock; the oldest
+ * spans are overwritten once a ring is full.
+ *
+ * Each span carries a name (the notifier's NamedInterface::name()
+ * or the activity name) and a kind. The kind of a notification defaults
+ * to the notifiee class, e.g. "Device::Notifiee", and can be refined
+ * per notification with kindNameIs:
+ *
+ *     Tracer::kindNameIs(&Device::Notifiee::onPort, "Device::onPort");
+ */
+
+#ifndef FWK_TRACER_H
+#define FWK_TRACER_H
+
+class Tracer {
+public:
+
+    /**
+     * Notification kind: either a readable name or a mangled type name
+     * that is demangled when the trace is written.
+     */
+    struct Kind {
+        const char* name;
+        bool mangled;
+
+        Kind(const char* const n, const bool m) :
+            name(n),
+            mangled(m)
+        {
+            // Nothing else to do.
+        }
+    };
+
+private:
+
+    static const U32 nameCapacity = 48;
+
+    static const U64 ringCapacity = 1 << 14;
+
+public:
+
+    /** Flag indicating whether spans are being recorded. */
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /** Modify the flag indicating whether spans are being recorded. */
+    static void enabledIs(const bool enabled) {
+        enabled_.store(enabled, std::memory_order_relaxed);
+    }
+
+
+    /**
+     * Name a notification so that spans delivering it report the given
+     * kind instead of the notifiee class. The name must outlive the tracer,
+     * normally a string literal. Kinds should be named before tracing
+     * is enabled because kind lookups do not lock.
+     */
+    template <class Notifiee, class Func>
+    static void kindNameIs(Func Notifiee::*func, const char* const name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        KindName kindName;
+        memcpy(kindName.key, &func, keySize(func));
+        kindName.size = keySize(func);
+        kindName.type = &typeid(func);
+        kindName.name = name;
+        kindNames_.push_back(kindName);
+    }
+
+    /**
+     * Return the kind for a given notification, which is either the name
+     * given to kindNameIs or the notifiee class.
+     */
+    template <class Notifiee, class Func>
+    static Kind kind(Func Notifiee::*func) {
+        for (const auto& k : kindNames_) {
+            if (k.type == &typeid(func) && k.size == keySize(func) &&
+                memcmp(k.key, &func, k.size) == 0
+            ) {
+                return Kind(k.name, false);
+            }
+        }
+
+        return Kind(typeid(Notifiee).name(), true);
+    }
+
+
+    /** Number of spans currently held in all ring buffers. */
+    static U64 spanCount() {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        U64 count = 0;
+        for (const auto& ring : rings_) {
+            count += ring->size();
+        }
+
+        return count;
+    }
+
+    /**
+     * Write all recorded spans as Chrome trace JSON and empty the ring
+     * buffers. Threads should not be recording while the rings are flushed.
+     */
+    _noinline
+    static void flush(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        out << "{\"traceEvents\":[";
+
+        bool first = true;
+        for (const auto& ring : rings_) {
+            const auto end = ring->head_.load(std::memory_order_acquire);
+            const auto begin = end > ringCapacity ? end - ringCapacity : 0;
+            for (auto i = begin; i < end; ++i) {
+                if (!first) {
+                    out << ",";
+                }
+                first = false;
+
+                writeEvent(out, ring->events_[i % ringCapacity], ring->tid_);
+            }
+
+            ring->head_.store(0, std::memory_order_release);
+        }
+
+        out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+
+    /**
+     * Span records the execution of the enclosing scope as one complete
+     * ("ph":"X") trace event when tracing is enabled.
+     */
+    class Span {
+    public:
+
+        Span(const string& name, const char* const kind) :
+            active_(enabled()),
+            kind_(kind, false)
+        {
+            if (active_) {
+                begin(name);
+            }
+        }
+
+        Span(const string& name, const Kind kind) :
+            active_(enabled()),
+            kind_(kind)
+        {
+            if (active_) {
+                begin(name);
+            }
+        }
+
+        /** Span for delivering a notification from a named notifier. */
+        template <class T, class Func>
+        Span(T* const notifier, Func T::Notifiee::*func) :
+            active_(enabled()),
+            kind_(null, false)
+        {
+            if (active_) {
+                kind_ = kind(func);
+                begin(notifier->name());
+            }
+        }
+
+        ~Span() {
+            if (active_) {
+                end();
+            }
+        }
+
+        Span(const Span&) = delete;
+
+        void operator =(const Span&) = delete;
+
+    private:
+
+        bool active_;
+        Kind kind_;
+        U64 begin_;
+        char name_[nameCapacity];
+
+
+        void begin(const string& name) {
+            Tracer::ring();
+
+            const auto n = name.size() < nameCapacity ?
+                name.size() : size_t(nameCapacity - 1);
+            memcpy(name_, name.data(), n);
+            name_[n] = '\0';
+
+            begin_ = nowNs();
+        }
+
+        _noinline
+        void end() {
+            auto& ring = Tracer::ring();
+            const auto i = ring.head_.load(std::memory_order_relaxed);
+
+            auto& event = ring.events_[i % ringCapacity];
+            memcpy(event.name, name_, nameCapacity);
+            event.kind = kind_;
+            event.begin = begin_;
+            event.end = nowNs();
+
+            ring.head_.store(i + 1, std::memory_order_release);
+        }
+
+    };
+
+
+    /**
+     * Wrap a deferred reaction so that its delivery is recorded with the
+     * notifier's name. Returns the reaction unchanged when tracing is off.
+     */
+    template <class T, class Func>
+    static std::function<void()> reaction(
+        T* const notifier, Func T::Notifiee::*func,
+        const std::function<void()>& reaction
+    ) {
+        if (!enabled()) {
+            return reaction;
+        }
+
+        const string name = notifier->name();
+        const auto k = kind(func);
+
+        return [=]() {
+            Span span(name, k);
+            reaction();
+        };
+    }
+
+private:
+
+    struct Event {
+        char name[nameCapacity];
+        Kind kind;
+        U64 begin;
+        U64 end;
+
+        Event() :
+            kind(null, false),
+            begin(0),
+            end(0)
+        {
+            name[0] = '\0';
+        }
+    };
+
+    /**
+     * Ring buffer written only by its owning thread. The head counts all
+     * spans ever written; the live spans are the last ringCapacity of them.
+     */
+    class Ring {
+    public:
+
+        explicit Ring(const U32 tid) :
+            tid_(tid),
+            head_(0),
+            events_(ringCapacity)
+        {
+            // Nothing else to do.
+        }
+
+        U64 size() const {
+            const auto head = head_.load(std::memory_order_acquire);
+            return head < ringCapacity ? head : ringCapacity;
+        }
+
+        U32 tid_;
+        std::atomic<U64> head_;
+        std::vector<Event> events_;
+
+    };
+
+    struct KindName {
+        char key[32];
+        size_t size;
+        const std::type_info* type;
+        const char* name;
+    };
+
+
+    static std::atomic<bool> enabled_;
+
+    static std::mutex mutex_;
+
+    static std::vector< std::unique_ptr<Ring> > rings_;
+
+    static std::vector<KindName> kindNames_;
+
+    static thread_local Ring* ring_;
+
+
+    template <class Func>
+    static size_t keySize(const Func&) {
+        static_assert(sizeof(Func) <= sizeof(KindName::key), "func too large");
+        return sizeof(Func);
+    }
+
+    static U64 nowNs() {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(
+            steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    /** Ring buffer for the calling thread, registered on first use. */
+    static Ring& ring() {
+        if (ring_ == null) {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            rings_.emplace_back(new Ring(U32(rings_.size() + 1)));
+            ring_ = rings_.back().get();
+        }
+
+        return *ring_;
+    }
+
+    static string kindString(const Kind kind) {
+        if (kind.name == null) {
+            return "";
+        }
+
+#if defined(__GNUC__) || defined(__clang__)
+        if (kind.mangled) {
+            int status = 0;
+            char* const s = abi::__cxa_demangle(kind.name, null, null, &status);
+            if (s != null) {
+                const string result(s);
+                free(s);
+                return result;
+            }
+        }
+#endif
+
+        return kind.name;
+    }
+
+    static void writeString(std::ostream& out, const string& s) {
+        out << '"';
+        for (const auto c : s) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (U8(c) < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", unsigned(c));
+                out << buf;
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+
+    static void writeEvent(std::ostream& out, const Event& e, const U32 tid) {
+        const auto kind = kindString(e.kind);
+
+        out << "\n{\"name\":";
+        writeString(out, e.name);
+        out << ",\"cat\":";
+        writeString(out, kind);
+        char times[64];
+        snprintf(
+            times, sizeof(times), "%llu.%03llu,\"dur\":%llu.%03llu",
+            (unsigned long long)(e.begin / 1000),
+            (unsigned long long)(e.begin % 1000),
+            (unsigned long long)((e.end - e.begin) / 1000),
+            (unsigned long long)((e.end - e.begin) % 1000)
+        );
+
+        out << ",\"ph\":\"X\",\"ts\":" << times <<
+            ",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"kind\":";
+        writeString(out, kind);
+        out << "}}";
+    }
+
+};
+
+std::atomic<bool> Tracer::enabled_(false);
+
+std::mutex Tracer::mutex_;
+
+std::vector< std::unique_ptr<Tracer::Ring> > Tracer::rings_;
+
+std::vector<Tracer::KindName> Tracer::kindNames_;
+
+thread_local Tracer::Ring* Tracer::ring_ = null;
+
+#endif
@@ -90,19 +90,35 @@
 
 
 #include <assert.h>
+#include <atomic>
+#include <chrono>
 #include <deque>
+#include <errno.h>
 #include <functional>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <typeinfo>
 #include <unordered_map>
 #include <vector>
 
+#if defined(__GNUC__) || defined(__clang__)
+#   include <cxxabi.h>
+#endif
+
+#ifndef _MSC_VER
+#   include <unistd.h>
+#endif
+
 using std::string;
 
 namespace fwk {
@@ -116,13 +132,10 @@ namespace fwk {
 #   include "fwk/Exception.h"
 #   include "fwk/Nominal.h"
 #   include "fwk/Ordinal.h"
-
-/**
- * Time as an abstract double representing a number of seconds.
- */
-class TimeType { };
-typedef Ordinal<TimeType, double> Time;
-
+#   include "fwk/Result.h"
+#   include "fwk/Tracer.h"
+#   include "fwk/Logger.h"
+#   include "fwk/Time.h"
 #   include "fwk/Activity.h"
 #   include "fwk/ActivityManager.h"
 #   include "fwk/NotifierLib.h"
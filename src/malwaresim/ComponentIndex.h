@@ -0,0 +1,225 @@
+/**
+ * Connected components of a network's port graph.
+ */
+
+#ifndef COMPONENTINDEX_H
+#define COMPONENTINDEX_H
+
+#include <vector>
+
+/**
+ * ComponentIndex answers whether two devices of a PortTable are linked
+ * by a chain of port connections, and how many devices such a component
+ * holds, with a union-find over device ids.
+ *
+ * New links are merged into the index as they are made, so a network that
+ * only gains devices and connections never rebuilds it. Union-find cannot
+ * split a component, so removing a link, removing a device or renumbering
+ * the ids marks the index stale, and the next query rebuilds it from
+ * the table in one pass over the rows.
+ *
+ * A query may also give a malware strength. Then a link counts only if
+ * neither of its ports blocks malware of that strength, so two devices
+ * share a component only if such malware could travel between them in
+ * either direction. The index for the last strength asked about is kept
+ * until the next change to a link or rating.
+ *
+ * Lookups use path halving and unions are by size, so each query is
+ * near-O(1).
+ */
+class ComponentIndex {
+public:
+
+    ComponentIndex() :
+        stale_(false),
+        strengthStale_(true),
+        strength_(0.0)
+    {
+        // Nothing else to do.
+    }
+
+
+    /** Flag indicating whether the given devices are in one component. */
+    bool connected(const PortTable& table, const U32 a, const U32 b) {
+        current(table);
+        return all_.find(a) == all_.find(b);
+    }
+
+    /** Number of devices in the component of the given device. */
+    U32 componentSize(const PortTable& table, const U32 id) {
+        current(table);
+        return all_.size(id);
+    }
+
+    /**
+     * Flag indicating whether the given devices are in one component
+     * of the links malware of the given strength can cross.
+     */
+    bool connected(
+        const PortTable& table, const U32 a, const U32 b,
+        const MalwareStrength strength
+    ) {
+        current(table, strength);
+        return open_.find(a) == open_.find(b);
+    }
+
+    /**
+     * Number of devices in the component of the given device among
+     * the links malware of the given strength can cross.
+     */
+    U32 componentSize(
+        const PortTable& table, const U32 id, const MalwareStrength strength
+    ) {
+        current(table, strength);
+        return open_.size(id);
+    }
+
+
+    /** Merge the components of two newly linked devices. */
+    void linkNew(const PortTable& table, const U32 a, const U32 b) {
+        strengthStale_ = true;
+        if (!stale_) {
+            all_.grow(table.deviceCount());
+            all_.unite(a, b);
+        }
+    }
+
+    /** Add a device, merging it with the devices it is already linked to. */
+    void deviceNew(const PortTable& table, const U32 id) {
+        strengthStale_ = true;
+        if (!stale_) {
+            all_.grow(table.deviceCount());
+            linksUnite(table, id, all_, null);
+        }
+    }
+
+    /** Note that a link was removed or devices were removed or renumbered. */
+    void staleIs() {
+        stale_ = true;
+        strengthStale_ = true;
+    }
+
+    /** Note that a port rating changed. */
+    void ratingIs() {
+        strengthStale_ = true;
+    }
+
+private:
+
+    /** Disjoint sets of device ids. */
+    class Sets {
+    public:
+
+        void clear() {
+            parent_.clear();
+            size_.clear();
+        }
+
+        void grow(const U32 n) {
+            for (auto id = U32(parent_.size()); id < n; ++id) {
+                parent_.push_back(id);
+                size_.push_back(1);
+            }
+        }
+
+        U32 find(U32 id) {
+            while (parent_[id] != id) {
+                parent_[id] = parent_[parent_[id]];
+                id = parent_[id];
+            }
+
+            return id;
+        }
+
+        U32 size(const U32 id) {
+            return size_[find(id)];
+        }
+
+        void unite(const U32 a, const U32 b) {
+            auto ra = find(a);
+            auto rb = find(b);
+            if (ra == rb) {
+                return;
+            }
+
+            if (size_[ra] < size_[rb]) {
+                std::swap(ra, rb);
+            }
+
+            parent_[rb] = ra;
+            size_[ra] += size_[rb];
+        }
+
+    private:
+
+        std::vector<U32> parent_;
+        std::vector<U32> size_;
+
+    };
+
+
+    Sets all_;
+    bool stale_;
+
+    Sets open_;
+    bool strengthStale_;
+    MalwareStrength strength_;
+
+
+    void current(const PortTable& table) {
+        if (stale_) {
+            rebuild(table, all_, null);
+            stale_ = false;
+        }
+    }
+
+    void current(const PortTable& table, const MalwareStrength strength) {
+        if (strengthStale_ || strength_.value() != strength.value()) {
+            // Ports whose rating is within the tolerance of the strength block.
+            const auto threshold = strength.value() - MalwareStrength::tol;
+            rebuild(table, open_, &threshold);
+            strengthStale_ = false;
+            strength_ = strength;
+        }
+    }
+
+    static void rebuild(
+        const PortTable& table, Sets& sets, const double* const threshold
+    ) {
+        sets.clear();
+        sets.grow(table.deviceCount());
+
+        const auto n = table.deviceCount();
+        for (U32 id = 0; id < n; ++id) {
+            linksUnite(table, id, sets, threshold);
+        }
+    }
+
+    /**
+     * Unite a device with each device it is linked to, skipping links
+     * with a port rated above the threshold if there is one.
+     */
+    static void linksUnite(
+        const PortTable& table, const U32 id, Sets& sets,
+        const double* const threshold
+    ) {
+        const auto end = table.portBegin(id) + table.portCount(id);
+        for (auto r = table.portBegin(id); r < end; ++r) {
+            const auto peer = table.peer(r);
+            if (peer == PortTable::none) {
+                continue;
+            }
+
+            if (threshold != null && (table.rating(r) > *threshold ||
+                table.rating(table.row(peer, table.peerPort(r))) > *threshold)
+            ) {
+                continue;
+            }
+
+            sets.unite(id, peer);
+        }
+    }
+
+};
+
+#endif
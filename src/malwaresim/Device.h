@@ -9,6 +9,7 @@
 #ifndef DEVICE_H
 #define DEVICE_H
 
+#include <algorithm>
 #include <vector>
 #include <list>
 
@@ -54,74 +55,215 @@ public:
     }
 
 
+    /**
+     * Id of this device's rows in its network's port table, or
+     * PortTable::none if the device is not in a network.
+     */
+    U32 id() const {
+        return id_;
+    }
+
+
+    /** Health states of a device. */
+    enum Health {
+        healthy,
+        infected
+    };
+
+
+    /** Current health of the device as "healthy" or "infected". */
+    const string& health() const {
+        return healthName(health_);
+    }
+
     /** Current health of the device. */
-    const string& health() {
+    Health healthState() const {
         return health_;
     }
 
-    /** Modify the health of this device. */
+    /** Modify the health of this device given "healthy" or "infected". */
     void healthIs(const string& health) {
-        if (health_ != health) {
-            if (health != "healthy" && health != "infected") {
-                throw std::invalid_argument(health);
-            }
+        if (health == healthName(healthy)) {
+            healthIs(healthy);
+        } else if (health == healthName(infected)) {
+            healthIs(infected);
+        } else {
+            throw std::invalid_argument(health);
+        }
+    }
 
+    /** Modify the health of this device. */
+    void healthIs(const Health health) {
+        if (health_ != health) {
             health_ = health;
+            if (portTable_ != null) {
+                portTable_->infectedIs(id_, health == infected);
+            }
 
             post(this, &Notifiee::onHealth);
         }
     }
 
+    /** Name of the given health state. */
+    static const string& healthName(const Health health) {
+        static const string names[] = { "healthy", "infected" };
+        return names[health];
+    }
+
 protected:
 
-    typedef std::vector<Port> PortVector;
+    typedef std::vector<PortLink> PortLinkVector;
 
     typedef std::list<Notifiee*> NotifieeList;
 
 public:
 
-    typedef PortVector::size_type size_type;
+    typedef PortLinkVector::size_type size_type;
+
+
+    /**
+     * The ports of a device for range-based iteration. Each Port is made
+     * when the iteration reaches it, as port(p) makes it, so iterating
+     * allocates nothing.
+     */
+    class PortRange {
+    public:
+
+        class Iterator {
+        public:
+
+            Port operator *() const {
+                return device_->port(p_);
+            }
+
+            Iterator& operator ++() {
+                ++p_;
+                return *this;
+            }
+
+            bool operator !=(const Iterator& i) const {
+                return p_ != i.p_;
+            }
+
+        private:
+
+            friend class PortRange;
+
+            Device* device_;
+            U32 p_;
+
+            Iterator(Device* const device, const U32 p) :
+                device_(device),
+                p_(p)
+            {
+                // Nothing else to do.
+            }
+
+        };
+
+
+        Iterator begin() const {
+            return Iterator(device_, 0);
+        }
+
+        Iterator end() const {
+            return Iterator(device_, U32(device_->portCount()));
+        }
+
+    private:
+
+        friend class Device;
+
+        Device* device_;
+
+        explicit PortRange(Device* const device) :
+            device_(device)
+        {
+            // Nothing else to do.
+        }
+
+    };
 
 
     /** Number of ports on the device. */
     size_type portCount() {
-        return ports_.size();
+        return links_.size();
     }
 
 
     /** Collection of ports on the device for range-based iteration. */
-    const PortVector& ports() {
-        return ports_;
+    PortRange ports() {
+        return PortRange(this);
     }
 
     /** Information for a specific port. */
-    const Port& port(const U32 p) {
-        return ports_[p];
+    Port port(const U32 p) {
+        return Port(ratings_->rating(p), links_[p]);
     }
 
 
     /** Anti-malware rating of a specific port. */
     const MalwareStrength portRating(const U32 p) {
-        return ports_[p].rating();
+        return ratings_->rating(p);
+    }
+
+    /**
+     * Table of this device's port ratings, which clones of the device
+     * share until one of them changes a rating.
+     */
+    const Ptr<PortRatings>& portRatings() const {
+        return ratings_;
     }
 
     /** Modify the anti-malware rating of a specific port. */
     _noinline
     void portRatingIs(const U32 p, const MalwareStrength& rating) {
-        Port& port = ports_[p];
-        if (port.rating() != rating) {
-            ports_[p].ratingIs(rating);
+        if (ratings_->rating(p) != rating) {
+            if (ratings_->references() > 1) {
+                ratings_ = PortRatings::instanceNew(*ratings_.ptr());
+            }
+
+            ratings_->ratingIs(p, rating);
+            if (portTable_ != null) {
+                portTable_->ratingIs(id_, p, rating.value());
+            }
+            componentRatingIs();
 
             post(this, &Notifiee::onPort, p);
         }
     }
 
+    /**
+     * Flags of the ports that let in malware of the given strength (those
+     * that do not block it, Port::blocks), bit i for port first + i,
+     * for up to 64 ports starting at first. The ratings are tested together
+     * by RatingKernel.
+     */
+    U64 openPorts(const MalwareStrength strength, const U32 first = 0) {
+        if (first >= portCount()) {
+            return 0;
+        }
+
+        const auto n = std::min<size_type>(64, portCount() - first);
+
+        double ratings[64];
+        for (U32 i = 0; i < n; ++i) {
+            ratings[i] = ratings_->rating(first + i).value();
+        }
+
+        U64 mask = 0;
+        RatingKernel::openMaskIs(
+            ratings, n, RatingKernel::openThreshold(strength), &mask
+        );
+        return mask;
+    }
+
 
     /**
      * Flag indicating whether a specific port is not connected to any device.
      */
     bool availablePort(const U32 p) {
-        return ports_[p].otherDevice() == null;
+        return links_[p].otherDevice() == null;
     }
 
     /**
@@ -131,14 +273,19 @@ public:
      * both for this device and the connected device.
      */
     void availablePortIsTrue(const U32 p) {
-        auto& port = ports_[p];
+        auto& port = links_[p];
         const auto otherDevice = port.otherDevice();
 
         if (otherDevice != null) {
             const auto p2 = port.otherPort();
 
             port.connectionIs(null, 0);
-            otherDevice->ports_[p2].connectionIs(null, 0);
+            otherDevice->links_[p2].connectionIs(null, 0);
+
+            portTableRowIs(p);
+            otherDevice->portTableRowIs(p2);
+            componentLinkDel();
+            otherDevice->componentLinkDel();
 
             post(this, &Notifiee::onPort, p);
             post(otherDevice.ptr(), &Notifiee::onPort, p2);
@@ -151,7 +298,7 @@ public:
      * if the port is available.
      */
     const Ptr<Device>& otherDevice(const U32 p) {
-        return ports_[p].otherDevice();
+        return links_[p].otherDevice();
     }
 
     /**
@@ -159,7 +306,7 @@ public:
      * the specified port.
      */
     U32 otherPort(const U32 p) {
-        return ports_[p].otherPort();
+        return links_[p].otherPort();
     }
 
     /**
@@ -180,8 +327,8 @@ public:
     void connectionIs(
         const U32 p, const Ptr<Device>& device, const U32 devicePort
     ) {
-        auto& port = ports_[p];
-        auto& otherPort = device->ports_[devicePort];
+        auto& port = links_[p];
+        auto& otherPort = device->links_[devicePort];
 
         if (port.otherDevice() == device && otherPort.otherDevice() == this) {
             // Ignore if connection already exists.
@@ -196,7 +343,9 @@ public:
         const auto& oldDevice = oldConnection.otherDevice();
         if (oldDevice != null) {
             const auto p2 = oldConnection.otherPort();
-            oldDevice->ports_[p2].connectionIs(null, 0);
+            oldDevice->links_[p2].connectionIs(null, 0);
+            oldDevice->portTableRowIs(p2);
+            oldDevice->componentLinkDel();
 
             post(oldDevice.ptr(), &Notifiee::onPort, p2);
         }
@@ -205,7 +354,9 @@ public:
         const auto& otherOldDevice = otherOldConnection.otherDevice();
         if (otherOldDevice != null) {
             const auto p2 = otherOldConnection.otherPort();
-            otherOldDevice->ports_[p2].connectionIs(null, 0);
+            otherOldDevice->links_[p2].connectionIs(null, 0);
+            otherOldDevice->portTableRowIs(p2);
+            otherOldDevice->componentLinkDel();
 
             post(otherOldDevice.ptr(), &Notifiee::onPort, p2);
         }
@@ -214,12 +365,28 @@ public:
         port.connectionIs(device, devicePort);
         otherPort.connectionIs(this, p);
 
+        portTableRowIs(p);
+        device->portTableRowIs(devicePort);
+        componentLinkNew(p);
+
         // Post notifications for both ports.
         post(this, &Notifiee::onPort, p);
         post(device.ptr(), &Notifiee::onPort, devicePort);
     }
 
 
+    /**
+     * Return a new device of the same type as this device with the given
+     * name and this device's ports and port ratings, sharing this device's
+     * rating table. The clone is not connected to any device and is not
+     * in any network.
+     */
+    _noinline
+    Ptr<Device> cloneNew(const string& name) {
+        return deviceNew(name, ratings_);
+    }
+
+
     /**
      * Collection of notifiees.
      */
@@ -242,9 +409,13 @@ protected:
 
     Network* network_;
 
-    PortVector ports_;
+    PortTable* portTable_;
+    U32 id_;
 
-    string health_;
+    PortLinkVector links_;
+    Ptr<PortRatings> ratings_;
+
+    Health health_;
 
     NotifieeList notifiees_;
 
@@ -253,14 +424,36 @@ protected:
     Device(const string& name, const U32 n, const MalwareStrength rating) :
         NamedInterface(name),
         network_(null),
-        ports_(n),
-        health_("healthy")
+        portTable_(null),
+        id_(PortTable::none),
+        links_(n),
+        ratings_(PortRatings::instanceNew(n, rating)),
+        health_(healthy)
     {
-        for (auto& port : ports_) {
-            port.ratingIs(rating);
-        }
+        // Nothing else to do.
     }
 
+    /** A device with one port for each rating in the given shared table. */
+    Device(const string& name, const Ptr<PortRatings>& ratings) :
+        NamedInterface(name),
+        network_(null),
+        portTable_(null),
+        id_(PortTable::none),
+        links_(ratings->portCount()),
+        ratings_(ratings),
+        health_(healthy)
+    {
+        // Nothing else to do.
+    }
+
+    /**
+     * Return a new device of this device's type with the given rating
+     * table, which it shares.
+     */
+    virtual Ptr<Device> deviceNew(
+        const string& name, const Ptr<PortRatings>& ratings
+    ) = 0;
+
     ~Device() {
         const auto n = portCount();
         for (U32 p = 0; p < n; ++p) {
@@ -271,6 +464,79 @@ protected:
     }
 
 
+    /**
+     * Move this device's ports into the given port table, or out of its
+     * current one if the table is null. Rows of connected devices in
+     * the same table are updated to match.
+     */
+    _noinline
+    void portTableIs(PortTable* const table) {
+        if (table == portTable_) {
+            return;
+        }
+
+        const auto n = U32(portCount());
+
+        if (portTable_ != null) {
+            for (U32 p = 0; p < n; ++p) {
+                const auto& other = links_[p].otherDevice();
+                if (other != null && other->portTable_ == portTable_) {
+                    portTable_->connectionIs(
+                        other->id_, links_[p].otherPort(), PortTable::none, 0
+                    );
+                }
+            }
+
+            portTable_->deviceDel(id_);
+            portTable_ = null;
+            id_ = PortTable::none;
+        }
+
+        if (table != null) {
+            portTable_ = table;
+            id_ = table->deviceNew(this, n);
+            table->infectedIs(id_, health_ == infected);
+
+            for (U32 p = 0; p < n; ++p) {
+                table->ratingIs(id_, p, ratings_->rating(p).value());
+
+                const auto& other = links_[p].otherDevice();
+                if (other != null && other->portTable_ == table) {
+                    portTableRowIs(p);
+                    other->portTableRowIs(links_[p].otherPort());
+                }
+            }
+        }
+    }
+
+    /** Copy the connection of port p into this device's port table row. */
+    void portTableRowIs(const U32 p) {
+        if (portTable_ == null) {
+            return;
+        }
+
+        const auto& link = links_[p];
+        const auto& other = link.otherDevice();
+        if (other != null && other->portTable_ == portTable_) {
+            portTable_->connectionIs(id_, p, other->id_, link.otherPort());
+        } else {
+            portTable_->connectionIs(id_, p, PortTable::none, 0);
+        }
+    }
+
+
+    // Defined in Network to handle cross-reference.
+
+    /** Merge the new link on port p into the network's component index. */
+    void componentLinkNew(U32 p);
+
+    /** Note a removed link in the network's component index. */
+    void componentLinkDel();
+
+    /** Note a changed port rating in the network's component index. */
+    void componentRatingIs();
+
+
     void networkIs(Network* const network) {
         if (network != network_) {
             network_ = network;
@@ -298,6 +564,10 @@ public:
 
 protected:
 
+    Ptr<Device> deviceNew(const string& name, const Ptr<PortRatings>& ratings) {
+        return new PersonalDevice(name, ratings);
+    }
+
     static const U32 defaultPortCount = 8;
 
     static constexpr double defaultRating = 0.0;
@@ -317,6 +587,12 @@ protected:
         // Nothing else to do.
     }
 
+    PersonalDevice(const string& name, const Ptr<PortRatings>& ratings) :
+        Device(name, ratings)
+    {
+        // Nothing else to do.
+    }
+
 };
 
 /**
@@ -335,6 +611,10 @@ public:
 
 protected:
 
+    Ptr<Device> deviceNew(const string& name, const Ptr<PortRatings>& ratings) {
+        return new MobileDevice(name, ratings);
+    }
+
     static constexpr double defaultRating = 0.9;
 
 
@@ -344,6 +624,12 @@ protected:
         // Nothing else to do.
     }
 
+    MobileDevice(const string& name, const Ptr<PortRatings>& ratings) :
+        PersonalDevice(name, ratings)
+    {
+        // Nothing else to do.
+    }
+
 };
 
 /**
@@ -372,6 +658,12 @@ protected:
         // Nothing else to do.
     }
 
+    NetworkDevice(const string& name, const Ptr<PortRatings>& ratings) :
+        Device(name, ratings)
+    {
+        // Nothing else to do.
+    }
+
 };
 
 class FirewallDevice : public NetworkDevice {
@@ -386,6 +678,10 @@ public:
 
 protected:
 
+    Ptr<Device> deviceNew(const string& name, const Ptr<PortRatings>& ratings) {
+        return new FirewallDevice(name, ratings);
+    }
+
     static constexpr double defaultRating = 1.0;
 
 
@@ -395,6 +691,12 @@ protected:
         // Nothing else to do.
     }
 
+    FirewallDevice(const string& name, const Ptr<PortRatings>& ratings) :
+        NetworkDevice(name, ratings)
+    {
+        // Nothing else to do.
+    }
+
 };
 
 #endif
@@ -0,0 +1,94 @@
+/**
+ * Growable array in one contiguous block, with PagedVector's interface.
+ */
+
+#ifndef FLATVECTOR_H
+#define FLATVECTOR_H
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * FlatVector holds a growable array in one std::vector, behind the same
+ * interface as PagedVector, so code written against one works with
+ * the other. It is what a live PortTable uses: a read is one load,
+ * and a write has no sharing to check.
+ *
+ * The whole array is one page, so kernels that scan a page at a time
+ * scan it in one call.
+ */
+template <class T>
+class FlatVector {
+public:
+
+    /** Larger than any index, so every element is on page 0. */
+    static constexpr size_t pageSize = size_t(1) << 40;
+
+
+    size_t size() const {
+        return values_.size();
+    }
+
+    bool empty() const {
+        return values_.empty();
+    }
+
+    const T& operator [](const size_t i) const {
+        return values_[i];
+    }
+
+    /** Elements, contiguous. */
+    const T* data() const {
+        return values_.data();
+    }
+
+
+    void valueIs(const size_t i, const T& value) {
+        values_[i] = value;
+    }
+
+    /**
+     * Copy the n elements starting at from to the n starting at to.
+     * The two ranges must not overlap.
+     */
+    void copyIs(const size_t to, const size_t from, const size_t n) {
+        std::copy_n(values_.data() + from, n, values_.data() + to);
+    }
+
+    void push_back(const T& value) {
+        values_.push_back(value);
+    }
+
+    /** Grow to the given size, filling new elements with the given value. */
+    void resize(const size_t size, const T& value) {
+        if (size > values_.size()) {
+            values_.resize(size, value);
+        }
+    }
+
+    void reserve(const size_t size) {
+        values_.reserve(size);
+    }
+
+    void swap(FlatVector& v) {
+        values_.swap(v.values_);
+    }
+
+
+    /** Number of pages: one, unless empty. */
+    size_t pageCount() const {
+        return values_.empty() ? 0 : 1;
+    }
+
+    /** Elements of the given page, which is all of them. */
+    const T* pageData(const size_t) const {
+        return values_.data();
+    }
+
+private:
+
+    std::vector<T> values_;
+
+};
+
+#endif
@@ -0,0 +1,312 @@
+/**
+ * Parallel breadth-first infection propagation.
+ */
+
+#ifndef INFECTIONENGINE_H
+#define INFECTIONENGINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * InfectionEngine spreads an infection through a network's PortTable,
+ * or a scenario's PagedPortTable, one BFS level at a time, splitting
+ * each frontier across threads.
+ *
+ * A row is open if it is connected and the rating of the peer's port,
+ * which is the port the malware must get through, does not block
+ * the strength. Rows are tested with RatingKernel a block of rows
+ * at a time into a bitmask, on the calling thread, when a level first
+ * reaches a device in the block; the claiming threads only read bits.
+ *
+ * A device is claimed by storing the smallest discovery key (position of
+ * the discovering device in BFS order, then port number) with an atomic
+ * compare-and-swap. Sorting each level by the winning keys reproduces the
+ * order in which the sequential breadth-first flood visits devices,
+ * so both the infected set and the order of onHealth notifications match
+ * it exactly. Health is applied on the calling thread once propagation
+ * finishes, because notifications are not thread-safe.
+ *
+ * An engine is meant to be kept and reused, as Network does. Its claims
+ * and open bits are reset after each infection for the devices and blocks
+ * it touched only, and infected devices are skipped as they are reached,
+ * so an infection costs time in proportion to the devices and ports it
+ * reaches rather than to the size of the network.
+ */
+class InfectionEngine {
+public:
+
+    /** Frontiers with fewer edges than this are processed on one thread. */
+    static const U32 parallelEdgeCount = 1 << 14;
+
+
+    explicit InfectionEngine(const U32 threadCount) :
+        threadCount_(threadCount == 0 ? 1 : threadCount),
+        claimCount_(0)
+    {
+        // Nothing else to do.
+    }
+
+
+    /** Maximum number of threads used per frontier. */
+    U32 threadCount() const {
+        return threadCount_;
+    }
+
+    /** Modify the maximum number of threads used per frontier. */
+    void threadCountIs(const U32 threadCount) {
+        threadCount_ = threadCount == 0 ? 1 : threadCount;
+    }
+
+
+    /**
+     * Infect the device with the given id and flood from it through
+     * the given table. Returns the newly infected devices in sequential
+     * BFS order; their health is modified.
+     */
+    template <class Table>
+    std::vector<Device*> infectionIs(
+        const Table& table, const MalwareStrength strength, const U32 id
+    ) {
+        const auto order = spreadNew(table, strength, id);
+
+        std::vector<Device*> infected;
+        infected.reserve(order.size());
+        for (const auto d : order) {
+            const auto device = table.device(d);
+            device->healthIs(Device::infected);
+            infected.push_back(device);
+        }
+
+        return infected;
+    }
+
+    /**
+     * Return the ids of the devices an infection of the device with
+     * the given id would reach, in sequential BFS order, without modifying
+     * anything. The table's devices are not dereferenced.
+     */
+    template <class Table>
+    _noinline
+    std::vector<U32> spreadNew(
+        const Table& table, const MalwareStrength strength, const U32 id
+    ) {
+        std::vector<U32> order;
+        if (id >= table.deviceCount() || table.device(id) == null ||
+            table.infected(id)
+        ) {
+            return order;
+        }
+
+        claimsIs(table.deviceCount());
+        threshold_ = RatingKernel::openThreshold(strength);
+
+        const auto blocks =
+            (table.rowCount() + blockRowCount - 1) / blockRowCount;
+        if (openBlock_.size() < blocks) {
+            open_.resize(size_t(blocks) * (blockRowCount / 64));
+            openBlock_.resize(blocks, 0);
+        }
+
+        order.push_back(id);
+        claim_[id].store(claimed, std::memory_order_relaxed);
+
+        size_t level = 0;
+        while (level < order.size()) {
+            const size_t levelEnd = order.size();
+            levelIs(table, order, level, levelEnd);
+            level = levelEnd;
+        }
+
+        // Every claimed device is in order, so this leaves all unclaimed.
+        for (const auto d : order) {
+            claim_[d].store(unclaimed, std::memory_order_relaxed);
+        }
+
+        for (const auto b : openBlocks_) {
+            openBlock_[b] = 0;
+        }
+        openBlocks_.clear();
+
+        return order;
+    }
+
+private:
+
+    static const U64 claimed = 0;
+
+    static const U64 unclaimed = ~U64(0);
+
+    /** Rows whose open bits are computed together. */
+    static const U32 blockRowCount = 256;
+
+
+    struct Candidate {
+        U64 key;
+        U32 device;
+
+        bool operator <(const Candidate& c) const {
+            return key < c.key;
+        }
+    };
+
+    typedef std::vector<Candidate> CandidateVector;
+
+
+    U32 threadCount_;
+
+    double threshold_;
+
+    /**
+     * Open bit of each row, valid in the blocks flagged in openBlock_,
+     * which are listed in openBlocks_.
+     */
+    std::vector<U64> open_;
+    std::vector<U8> openBlock_;
+    std::vector<U32> openBlocks_;
+
+    /** Claim of each device, unclaimed between infections. */
+    std::unique_ptr< std::atomic<U64>[] > claim_;
+    U32 claimCount_;
+
+
+    /** Make room for claims on the given number of devices. */
+    void claimsIs(const U32 n) {
+        if (n <= claimCount_) {
+            return;
+        }
+
+        const auto count = std::max(n, 2 * claimCount_);
+        claim_.reset(new std::atomic<U64>[count]);
+        for (U32 d = 0; d < count; ++d) {
+            claim_[d].store(unclaimed, std::memory_order_relaxed);
+        }
+        claimCount_ = count;
+    }
+
+    /** Compute the open bits of the given blocks of rows, if not yet done. */
+    template <class Table>
+    void openIs(
+        const Table& table, const U32 firstBlock, const U32 lastBlock
+    ) {
+        for (auto b = firstBlock; b <= lastBlock; ++b) {
+            if (openBlock_[b]) {
+                continue;
+            }
+
+            const auto begin = b * blockRowCount;
+            const auto end = std::min(begin + blockRowCount, table.rowCount());
+            table.openRowsIs(begin, end, threshold_, &open_[begin / 64]);
+            openBlock_[b] = 1;
+            openBlocks_.push_back(b);
+        }
+    }
+
+    /**
+     * Process order[begin, end) and append the next level to order,
+     * sorted by discovery key.
+     */
+    template <class Table>
+    void levelIs(
+        const Table& table, std::vector<U32>& order,
+        const size_t begin, const size_t end
+    ) {
+        U64 edges = 0;
+        for (auto i = begin; i < end; ++i) {
+            const auto first = table.portBegin(order[i]);
+            const auto count = table.portCount(order[i]);
+            edges += count;
+
+            if (count != 0) {
+                openIs(
+                    table, first / blockRowCount, (first + count - 1) / blockRowCount
+                );
+            }
+        }
+
+        auto threads = U32(edges / parallelEdgeCount);
+        threads = threads < 1 ? 1 : (threads > threadCount_ ? threadCount_ : threads);
+
+        std::vector<CandidateVector> candidates(threads);
+        if (threads == 1) {
+            claimsIs(table, order, begin, end, candidates[0]);
+        } else {
+            const auto chunk = (end - begin + threads - 1) / threads;
+
+            std::vector<std::thread> workers;
+            for (U32 t = 0; t < threads; ++t) {
+                const auto b = std::min(end, begin + t * chunk);
+                const auto e = std::min(end, b + chunk);
+                workers.emplace_back([this, &table, &order, b, e, &candidates, t]() {
+                    claimsIs(table, order, b, e, candidates[t]);
+                });
+            }
+
+            for (auto& w : workers) {
+                w.join();
+            }
+        }
+
+        CandidateVector next;
+        for (const auto& c : candidates) {
+            for (const auto& candidate : c) {
+                if (claim_[candidate.device].load(std::memory_order_relaxed) ==
+                    candidate.key
+                ) {
+                    next.push_back(candidate);
+                }
+            }
+        }
+
+        std::sort(next.begin(), next.end());
+        for (const auto& candidate : next) {
+            order.push_back(candidate.device);
+        }
+    }
+
+    /**
+     * Claim the devices reachable in one step from order[begin, end),
+     * recording every claim this thread made. A claim can later be lost
+     * to a smaller key from another thread; the caller filters those out.
+     */
+    template <class Table>
+    void claimsIs(
+        const Table& table, const std::vector<U32>& order,
+        const size_t begin, const size_t end, CandidateVector& candidates
+    ) {
+        for (auto i = begin; i < end; ++i) {
+            const auto d = order[i];
+            const auto first = table.portBegin(d);
+            const auto count = table.portCount(d);
+
+            const auto base = U64(i + 1) << 32;
+            for (U32 p = 0; p < count; ++p) {
+                const auto r = first + p;
+                if (((open_[r / 64] >> (r % 64)) & 1) == 0) {
+                    continue;
+                }
+
+                const auto peer = table.peer(first + p);
+                if (table.infected(peer)) {
+                    continue;
+                }
+
+                const auto key = base | p;
+
+                auto current = claim_[peer].load(std::memory_order_relaxed);
+                while (key < current) {
+                    if (claim_[peer].compare_exchange_weak(current, key)) {
+                        candidates.push_back(Candidate{key, peer});
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+};
+
+#endif
@@ -0,0 +1,347 @@
+/**
+ * Malware spreading through a network over simulated time.
+ */
+
+#ifndef INFECTIONSPREAD_H
+#define INFECTIONSPREAD_H
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using fwk::Activity;
+using fwk::ActivityManager;
+
+/**
+ * InfectionSpread infects a network over simulated time instead of all
+ * at once. Malware crossing into a port arrives after the port's
+ * transmissionDelay, and gets through with the port's
+ * transmissionProbability. A healthy device is infected when malware
+ * first arrives at it, and from there the malware tries every connection
+ * to a healthy device, as Network::infectionIs does.
+ *
+ * Each pending crossing (hop) is a small record in a binary heap ordered
+ * by arrival time and then by the order the hops were made, and the heap's
+ * storage is reused from hop to hop. The spread owns one activity, which
+ * the activity manager runs once for each distinct arrival time. A run
+ * delivers every hop due by then and schedules the activity for the next
+ * one, so a hop costs a heap push and pop, not an activity, a posting
+ * or a std::function.
+ *
+ * Random draws come from a SplitMix64 stream started from seed, so a spread
+ * repeats exactly for the same seed and the same infections.
+ *
+ * Hops into a device that leaves the network are dropped; removing
+ * a single device scans the pending hops.
+ */
+class InfectionSpread : public fwk::PtrInterface {
+public:
+
+    /** Return a spread over the given network run by the given manager. */
+    static Ptr<InfectionSpread> instanceNew(
+        const Ptr<Network>& network, const Ptr<ActivityManager>& manager
+    ) {
+        return new InfectionSpread(network, manager);
+    }
+
+
+    /** Time for malware to cross a port with a rating of 0. */
+    Time hopTime() const {
+        return hopTime_;
+    }
+
+    void hopTimeIs(const Time time) {
+        hopTime_ = time;
+    }
+
+
+    U64 seed() const {
+        return seed_;
+    }
+
+    /** Modify the seed, restarting the random stream. */
+    void seedIs(const U64 seed) {
+        seed_ = seed;
+        state_ = seed;
+    }
+
+
+    /** Number of hops that have not yet arrived. */
+    size_t hopCount() const {
+        return hops_.size();
+    }
+
+    /** Number of devices this spread has infected. */
+    U32 infectedCount() const {
+        return infectedCount_;
+    }
+
+
+    /**
+     * Let malware of the given strength in on the given port of the device,
+     * crossing the port as it would cross from a connected device.
+     */
+    _noinline
+    void infectionIs(
+        const MalwareStrength strength, const Ptr<Device>& device, const U32 port
+    ) {
+        if (device->network() != network_.ptr() ||
+            device->healthState() == Device::infected
+        ) {
+            return;
+        }
+
+        hopNew(
+            manager_->now().ticks(), device.ptr(), device->port(port).rating().value(),
+            strength.value()
+        );
+        scheduleIs();
+    }
+
+
+    InfectionSpread(const InfectionSpread&) = delete;
+
+    void operator =(const InfectionSpread&) = delete;
+
+private:
+
+    static constexpr S64 unscheduled = std::numeric_limits<S64>::max();
+
+
+    /** Malware of some strength due to arrive at a device. */
+    struct Hop {
+        S64 ticks;
+        U64 sequence;
+        Device* device;
+        double strength;
+    };
+
+    /** Heap order: the hop that arrives first is at the top. */
+    struct Later {
+        bool operator ()(const Hop& h1, const Hop& h2) const {
+            if (h1.ticks != h2.ticks) {
+                return h1.ticks > h2.ticks;
+            }
+
+            return h1.sequence > h2.sequence;
+        }
+    };
+
+
+    /**
+     * Runs the spread whenever its activity runs. The run is queued on
+     * the activity rather than made from onStatus, because the activity
+     * clears its schedule after posting onStatus(running) and before
+     * delivering its queue; a run made from the queue can schedule
+     * the next one with nextTimeIs.
+     */
+    class ActivityReactor : public Activity::Notifiee {
+    public:
+
+        explicit ActivityReactor(InfectionSpread* const spread) :
+            spread_(spread)
+        {
+            // Nothing else to do.
+        }
+
+        void onStatus() {
+            if (notifier()->status() == Activity::running) {
+                const auto spread = spread_;
+                notifier()->postingNew(this, [spread]() { spread->run(); });
+            }
+        }
+
+    private:
+
+        InfectionSpread* spread_;
+
+    };
+
+    /** Drops hops into devices that leave the network. */
+    class NetworkReactor : public Network::Notifiee {
+    public:
+
+        explicit NetworkReactor(InfectionSpread* const spread) :
+            spread_(spread)
+        {
+            // Nothing else to do.
+        }
+
+        void onDeviceDel(const Ptr<Device>& device) {
+            const auto d = device.ptr();
+            spread_->hopsDel([d](const Hop& hop) { return hop.device == d; });
+        }
+
+        void onDevicesDel(const std::vector< Ptr<Device> >& devices) {
+            // Every hop's device is still alive here: the removed devices
+            // are held by the notification and earlier removals were purged.
+            const auto network = notifier().ptr();
+            spread_->hopsDel([network](const Hop& hop) {
+                return hop.device->network() != network;
+            });
+        }
+
+        void onNetworkDestroyed() {
+            spread_->hopsDel([](const Hop& hop) { return true; });
+        }
+
+    private:
+
+        InfectionSpread* spread_;
+
+    };
+
+
+    static U64 instanceCount_;
+
+
+    Ptr<Network> network_;
+    Ptr<ActivityManager> manager_;
+    Ptr<Activity> activity_;
+    Ptr<ActivityReactor> activityReactor_;
+    Ptr<NetworkReactor> networkReactor_;
+
+    Time hopTime_;
+    U64 seed_;
+    U64 state_;
+
+    std::vector<Hop> hops_;
+    U64 sequence_;
+    S64 scheduledTicks_;
+    U32 infectedCount_;
+
+
+    InfectionSpread(
+        const Ptr<Network>& network, const Ptr<ActivityManager>& manager
+    ) :
+        network_(network),
+        manager_(manager),
+        hopTime_(1.0),
+        seed_(1),
+        state_(1),
+        sequence_(0),
+        scheduledTicks_(unscheduled),
+        infectedCount_(0)
+    {
+        activity_ = manager->activityNew(
+            "InfectionSpread-" + std::to_string(++instanceCount_)
+        );
+
+        activityReactor_ = new ActivityReactor(this);
+        activityReactor_->notifierIs(activity_);
+
+        networkReactor_ = new NetworkReactor(this);
+        networkReactor_->notifierIs(network);
+    }
+
+    ~InfectionSpread() {
+        manager_->activityDel(activity_->name());
+    }
+
+
+    /** Uniform value in [0, 1) from the next step of the stream. */
+    double uniform() {
+        auto x = (state_ += 0x9e3779b97f4a7c15ull);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return double(x >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /**
+     * Try to cross a port with the given rating into the device,
+     * starting at the given time.
+     */
+    void hopNew(
+        const S64 ticks, Device* const device, const double rating,
+        const double strength
+    ) {
+        const auto p = Port::transmissionProbability(rating, strength);
+        if (p <= 0 || (p < 1 && uniform() >= p)) {
+            return;
+        }
+
+        const auto delay = Port::transmissionDelay(rating, hopTime_).ticks();
+        hops_.push_back(Hop{ ticks + delay, sequence_++, device, strength });
+        std::push_heap(hops_.begin(), hops_.end(), Later());
+    }
+
+    template <class Pred>
+    void hopsDel(const Pred& pred) {
+        hops_.erase(std::remove_if(hops_.begin(), hops_.end(), pred), hops_.end());
+        std::make_heap(hops_.begin(), hops_.end(), Later());
+    }
+
+    /** Deliver every hop due by now, then schedule the next run. */
+    _noinline
+    void run() {
+        const auto now = manager_->now().ticks();
+        if (scheduledTicks_ <= now) {
+            scheduledTicks_ = unscheduled;
+        }
+
+        while (!hops_.empty() && hops_.front().ticks <= now) {
+            std::pop_heap(hops_.begin(), hops_.end(), Later());
+            const auto hop = hops_.back();
+            hops_.pop_back();
+
+            arrive(hop);
+        }
+
+        scheduleIs();
+    }
+
+    void arrive(const Hop& hop) {
+        // Reactions to the infection may remove the device.
+        const Ptr<Device> device = hop.device;
+        if (device->network() != network_.ptr() ||
+            device->healthState() == Device::infected
+        ) {
+            return;
+        }
+
+        device->healthIs(Device::infected);
+        ++infectedCount_;
+
+        const auto id = device->id();
+        if (device->network() != network_.ptr() || id == PortTable::none) {
+            return;
+        }
+
+        const auto& table = network_->portTable();
+        const auto end = table.portBegin(id) + table.portCount(id);
+        for (auto r = table.portBegin(id); r < end; ++r) {
+            const auto peer = table.peer(r);
+            if (peer == PortTable::none || table.infected(peer)) {
+                continue;
+            }
+
+            hopNew(
+                hop.ticks, table.device(peer),
+                table.rating(table.row(peer, table.peerPort(r))), hop.strength
+            );
+        }
+    }
+
+    /**
+     * Schedule the activity for the next hop unless it is already
+     * scheduled for that time or earlier. A run of the activity schedules
+     * it again through nextTimeIs; otherwise it is added to the manager.
+     */
+    void scheduleIs() {
+        if (hops_.empty() || hops_.front().ticks >= scheduledTicks_) {
+            return;
+        }
+
+        scheduledTicks_ = hops_.front().ticks;
+        activity_->nextTimeIs(Time::fromTicks(scheduledTicks_));
+        if (activity_->status() != Activity::running) {
+            manager_->activityAdd(activity_);
+        }
+    }
+
+};
+
+U64 InfectionSpread::instanceCount_ = 0;
+
+#endif
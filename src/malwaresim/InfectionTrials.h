@@ -0,0 +1,429 @@
+/**
+ * Monte Carlo what-if trials of infections on a network snapshot.
+ */
+
+#ifndef INFECTIONTRIALS_H
+#define INFECTIONTRIALS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * InfectionTrials runs many independent, randomized infections against
+ * an immutable snapshot of a network's devices and port connections,
+ * leaving the live network untouched.
+ *
+ * Each trial picks a random device and entry port, a strength uniformly
+ * between strengthMin and strengthMax, and perturbs every port rating
+ * by up to ratingNoise in either direction (clamped to 0..1). Crossing
+ * a connection takes an exponentially distributed time with mean hopTime.
+ * Devices that are infected in the snapshot stay infected and are never
+ * entered. The infection spreads exactly as Network::infectionIs does;
+ * the hop times only decide when each device is reached.
+ *
+ * Each trial records the number of devices it infected, its reach depth
+ * (the most hops from the entry device to any device it infected, along
+ * the fastest route) and its time to contain (when the last device was
+ * infected).
+ *
+ * All randomness for a trial comes from a stream seeded by the runner's
+ * seed and the trial number, so results do not depend on the number
+ * of threads or on how trials are scheduled across them. Trials run
+ * on up to threadCount threads, each with its own scratch health bitmap,
+ * arrival times and queue.
+ */
+class InfectionTrials : public fwk::PtrInterface {
+public:
+
+    /** Result of one trial. */
+    struct Trial {
+        U32 device;
+        U32 port;
+        double strength;
+        U32 infectedCount;
+        U32 depth;
+        double containTime;
+    };
+
+    /** Summary statistics of one measure over all trials. */
+    struct Distribution {
+        double min;
+        double max;
+        double mean;
+        double p50;
+        double p90;
+        double p99;
+    };
+
+    /** Trials and the distributions of their measures. */
+    struct Summary {
+        std::vector<Trial> trials;
+        Distribution infectedCount;
+        Distribution depth;
+        Distribution containTime;
+    };
+
+
+    /** Return trials over a snapshot of the given network as it is now. */
+    static Ptr<InfectionTrials> instanceNew(const Ptr<Network>& network) {
+        return new InfectionTrials(network->portTable());
+    }
+
+
+    U32 trialCount() const {
+        return trialCount_;
+    }
+
+    void trialCountIs(const U32 count) {
+        trialCount_ = count;
+    }
+
+
+    U64 seed() const {
+        return seed_;
+    }
+
+    void seedIs(const U64 seed) {
+        seed_ = seed;
+    }
+
+
+    MalwareStrength strengthMin() const {
+        return strengthMin_;
+    }
+
+    void strengthMinIs(const MalwareStrength strength) {
+        strengthMin_ = strength;
+    }
+
+
+    MalwareStrength strengthMax() const {
+        return strengthMax_;
+    }
+
+    void strengthMaxIs(const MalwareStrength strength) {
+        strengthMax_ = strength;
+    }
+
+
+    /** Largest change to a port rating in either direction. */
+    double ratingNoise() const {
+        return ratingNoise_;
+    }
+
+    void ratingNoiseIs(const double noise) {
+        ratingNoise_ = noise;
+    }
+
+
+    /** Mean time, in seconds, for malware to cross one connection. */
+    double hopTime() const {
+        return hopTime_;
+    }
+
+    void hopTimeIs(const double time) {
+        hopTime_ = time;
+    }
+
+
+    U32 threadCount() const {
+        return threadCount_;
+    }
+
+    void threadCountIs(const U32 count) {
+        threadCount_ = count == 0 ? 1 : count;
+    }
+
+
+    /** Run trialCount trials and summarize them. */
+    _noinline
+    Summary summaryNew() const {
+        Summary summary;
+        summary.trials.resize(live_.empty() ? 0 : trialCount_);
+
+        std::atomic<U32> next(0);
+        const auto work = [this, &summary, &next]() {
+            Scratch scratch(*this);
+            for (;;) {
+                const auto t = next.fetch_add(1, std::memory_order_relaxed);
+                if (t >= summary.trials.size()) {
+                    return;
+                }
+
+                summary.trials[t] = trial(t, scratch);
+            }
+        };
+
+        const auto threads =
+            std::min<size_t>(threadCount_, summary.trials.size());
+        if (threads <= 1) {
+            work();
+        } else {
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < threads; ++i) {
+                workers.emplace_back(work);
+            }
+
+            for (auto& w : workers) {
+                w.join();
+            }
+        }
+
+        std::vector<double> values(summary.trials.size());
+
+        for (size_t t = 0; t < values.size(); ++t) {
+            values[t] = summary.trials[t].infectedCount;
+        }
+        summary.infectedCount = distribution(values);
+
+        for (size_t t = 0; t < values.size(); ++t) {
+            values[t] = summary.trials[t].depth;
+        }
+        summary.depth = distribution(values);
+
+        for (size_t t = 0; t < values.size(); ++t) {
+            values[t] = summary.trials[t].containTime;
+        }
+        summary.containTime = distribution(values);
+
+        return summary;
+    }
+
+
+    InfectionTrials(const InfectionTrials&) = delete;
+
+    void operator =(const InfectionTrials&) = delete;
+
+private:
+
+    static const U32 wordBits = 64;
+
+
+    /** Per-thread state reused from trial to trial. */
+    struct Scratch {
+        std::vector<U64> infected;
+        std::vector<double> arrival;
+        std::vector<U32> touched;
+
+        explicit Scratch(const InfectionTrials& trials) :
+            arrival(trials.portBegin_.size() - 1, -1.0)
+        {
+            // Nothing else to do.
+        }
+    };
+
+    /** Device reached at a time along a route of some number of hops. */
+    struct Arrival {
+        double time;
+        U32 device;
+        U32 depth;
+
+        bool operator <(const Arrival& a) const {
+            return time > a.time || (time == a.time && device > a.device);
+        }
+    };
+
+
+    // Snapshot of the port table.
+    std::vector<U32> live_;
+    std::vector<U32> portBegin_;
+    std::vector<U32> peer_;
+    std::vector<U32> peerPort_;
+    std::vector<double> rating_;
+    std::vector<U64> infected_;
+
+    U32 trialCount_;
+    U64 seed_;
+    MalwareStrength strengthMin_;
+    MalwareStrength strengthMax_;
+    double ratingNoise_;
+    double hopTime_;
+    U32 threadCount_;
+
+
+    explicit InfectionTrials(const PortTable& table) :
+        trialCount_(1000),
+        seed_(1),
+        strengthMin_(0.0),
+        strengthMax_(1.0),
+        ratingNoise_(0.0),
+        hopTime_(1.0),
+        threadCount_(std::max(1u, std::thread::hardware_concurrency()))
+    {
+        const auto n = table.deviceCount();
+        const auto rows = table.rowCount();
+
+        portBegin_.reserve(n + 1);
+        for (U32 id = 0; id < n; ++id) {
+            portBegin_.push_back(table.portBegin(id));
+            if (table.device(id) != null) {
+                live_.push_back(id);
+            }
+        }
+        portBegin_.push_back(rows);
+
+        peer_.reserve(rows);
+        peerPort_.reserve(rows);
+        rating_.reserve(rows);
+        for (U32 r = 0; r < rows; ++r) {
+            peer_.push_back(table.peer(r));
+            peerPort_.push_back(table.peerPort(r));
+            rating_.push_back(table.rating(r));
+        }
+
+        infected_.assign((n + wordBits - 1) / wordBits, 0);
+        table.infectedEach([this](const U32 id) {
+            infected_[id / wordBits] |= U64(1) << (id % wordBits);
+        });
+    }
+
+    ~InfectionTrials() {
+        // Nothing to do.
+    }
+
+
+    /** SplitMix64 step: a well-mixed 64-bit value from a counter. */
+    static U64 mix(U64 x) {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    /** Uniform value in [0, 1) for the given trial stream and index. */
+    static double uniform(const U64 stream, const U64 i) {
+        return double(mix(stream ^ mix(i)) >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /** Rating of the given row in the trial with the given stream. */
+    double rating(const U64 stream, const U32 row) const {
+        if (ratingNoise_ == 0) {
+            return rating_[row];
+        }
+
+        const auto r = rating_[row] +
+            ratingNoise_ * (2 * uniform(stream, 2 * U64(row) + 4) - 1);
+        return r < 0 ? 0 : (r > 1 ? 1 : r);
+    }
+
+    /** Time to cross from the given row to its peer. */
+    double hop(const U64 stream, const U32 row) const {
+        return -hopTime_ * std::log(1 - uniform(stream, 2 * U64(row) + 5));
+    }
+
+
+    Trial trial(const U32 t, Scratch& scratch) const {
+        const auto stream = mix(seed_ ^ mix(t));
+
+        Trial result;
+        result.device = live_[U32(uniform(stream, 0) * live_.size())];
+        const auto ports = portBegin_[result.device + 1] - portBegin_[result.device];
+        result.port = U32(uniform(stream, 1) * ports);
+        result.strength = strengthMin_.value() +
+            (strengthMax_.value() - strengthMin_.value()) * uniform(stream, 2);
+        result.infectedCount = 0;
+        result.depth = 0;
+        result.containTime = 0;
+
+        // Ports whose rating is within the tolerance of the strength block.
+        const auto threshold = result.strength - MalwareStrength::tol;
+
+        scratch.infected = infected_;
+        if (isInfected(scratch, result.device) ||
+            rating(stream, portBegin_[result.device] + result.port) > threshold
+        ) {
+            return result;
+        }
+
+        std::priority_queue<Arrival> queue;
+        queue.push(Arrival{0.0, result.device, 0});
+
+        while (!queue.empty()) {
+            const auto a = queue.top();
+            queue.pop();
+
+            if (isInfected(scratch, a.device)) {
+                continue;
+            }
+
+            infectedIs(scratch, a.device);
+            ++result.infectedCount;
+            result.depth = std::max(result.depth, a.depth);
+            result.containTime = a.time;
+
+            const auto end = portBegin_[a.device + 1];
+            for (auto r = portBegin_[a.device]; r < end; ++r) {
+                const auto peer = peer_[r];
+                if (peer == PortTable::none || isInfected(scratch, peer)) {
+                    continue;
+                }
+
+                const auto entry = portBegin_[peer] + peerPort_[r];
+                if (rating(stream, entry) > threshold) {
+                    continue;
+                }
+
+                const auto time = a.time + hop(stream, r);
+                auto& arrival = scratch.arrival[peer];
+                if (arrival < 0) {
+                    scratch.touched.push_back(peer);
+                } else if (arrival <= time) {
+                    continue;
+                }
+
+                arrival = time;
+                queue.push(Arrival{time, peer, a.depth + 1});
+            }
+        }
+
+        for (const auto d : scratch.touched) {
+            scratch.arrival[d] = -1.0;
+        }
+        scratch.touched.clear();
+
+        return result;
+    }
+
+    static bool isInfected(const Scratch& scratch, const U32 d) {
+        return (scratch.infected[d / wordBits] >> (d % wordBits)) & 1;
+    }
+
+    static void infectedIs(Scratch& scratch, const U32 d) {
+        scratch.infected[d / wordBits] |= U64(1) << (d % wordBits);
+    }
+
+
+    static Distribution distribution(std::vector<double>& values) {
+        Distribution d = { 0, 0, 0, 0, 0, 0 };
+        if (values.empty()) {
+            return d;
+        }
+
+        std::sort(values.begin(), values.end());
+
+        double sum = 0;
+        for (const auto v : values) {
+            sum += v;
+        }
+
+        const auto at = [&values](const double q) {
+            return values[size_t(q * double(values.size() - 1) + 0.5)];
+        };
+
+        d.min = values.front();
+        d.max = values.back();
+        d.mean = sum / double(values.size());
+        d.p50 = at(0.5);
+        d.p90 = at(0.9);
+        d.p99 = at(0.99);
+
+        return d;
+    }
+
+};
+
+#endif
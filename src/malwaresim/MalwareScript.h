@@ -0,0 +1,915 @@
+/**
+ * Compiled form of a Malware Simulation script.
+ */
+
+#ifndef MALWARESCRIPT_H
+#define MALWARESCRIPT_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+/**
+ * MalwareScript is a script compiled for MalwareSim: one instruction per
+ * command, with keywords decoded, numbers and ports parsed, and every
+ * network and device name interned as a small integer, so running
+ * the script again does no lexing and no name hashing.
+ *
+ * A number or port written as $name is a parameter, bound when the script
+ * runs (MalwareSim::parameterIs), so one compiled script can run over
+ * a sweep of values.
+ *
+ * Mistakes that can be seen by reading a line, such as an unknown keyword
+ * or a missing argument, compile into error instructions. A token that is
+ * not a valid number or port is kept with its operand, because whether
+ * the error is reported depends on the checks that run before it.
+ *
+ * Scripts can be written to and read from files in a compact binary form,
+ * keyed by a hash of the script text, so MalwareSim can cache them on disk.
+ */
+class MalwareScript : public fwk::PtrInterface {
+public:
+
+    typedef std::string_view Token;
+
+
+    /** Operation of an instruction. */
+    enum Op : U8 {
+        error,
+        networkNew,
+        personalNew,
+        mobileNew,
+        firewallNew,
+        cloneAll,
+        infectionIs,
+        infectedDel,
+        ratingIs,
+        connectionIs,
+        clone
+    };
+
+    /** Message of an error instruction. */
+    enum Message : U8 {
+        unknownCommand,
+        incompleteCommand,
+        extraArguments,
+        unknownNetworkCommand,
+        unknownDeviceCommand,
+        expectedDeviceName,
+        expectedTwoPorts,
+        expectedInfection,
+        expectedDevicePort
+    };
+
+    /** Checks that pass before an error instruction reports its error. */
+    enum Stage : U8 {
+        /** None: the error is reported at once. */
+        immediate,
+
+        /** The network must exist. */
+        afterNetwork,
+
+        /** The network, device and first port must be valid. */
+        afterPort
+    };
+
+    /** Span of the script's name text. */
+    struct Text {
+        U32 begin;
+        U32 size;
+    };
+
+    /**
+     * Number or port argument, parsed when the script is compiled.
+     * Its token is kept for error messages (text).
+     */
+    struct Operand {
+        double value;
+        U32 text;
+
+        /** Index of the parameter named by the token, or noParameter. */
+        U32 parameter : 30;
+
+        /** Flag indicating whether the token is a valid number. */
+        U32 number : 1;
+
+        /** Flag indicating whether the token is a valid port. */
+        U32 port : 1;
+    };
+
+    /**
+     * One command. Its name arguments are name ids, and its number
+     * and port arguments are the operands from operandBegin to operandEnd.
+     */
+    struct Instruction {
+        U32 line;
+        Op op;
+        Stage stage;
+        Message message;
+
+        /** Token an error instruction reports (text), or none. */
+        U32 token;
+
+        U32 network;
+        U32 device;
+        U32 device2;
+        U32 operandBegin;
+        U32 operandEnd;
+    };
+
+
+    /** Id of a missing name or token. */
+    static constexpr U32 none = ~U32(0);
+
+    /** Operand::parameter of an operand that is not a parameter. */
+    static constexpr U32 noParameter = (U32(1) << 30) - 1;
+
+
+    /** Return an empty script. */
+    static Ptr<MalwareScript> instanceNew() {
+        return new MalwareScript();
+    }
+
+    /** Return the script compiled from the given text. */
+    static Ptr<MalwareScript> instanceNew(
+        const char* const data, const size_t size
+    ) {
+        const Ptr<MalwareScript> script = new MalwareScript();
+        // Most lines are commands with one or two operands.
+        const auto lines = size_t(std::count(data, data + size, '\n')) + 1;
+        script->instructions_.reserve(lines);
+        script->operands_.reserve(2 * lines);
+
+        script->compile(data, data + size, none);
+        return script;
+    }
+
+
+    /** FNV-1a 64-bit hash of a script's text, the key of a cached script. */
+    static U64 textHash(const char* const data, const size_t size) {
+        U64 h = 14695981039346656037ull;
+        for (size_t i = 0; i < size; ++i) {
+            h = (h ^ U8(data[i])) * 1099511628211ull;
+        }
+
+        return h;
+    }
+
+
+    /** Text reported for an error instruction's message. */
+    static const char* message(const Message m) {
+        static const char* const messages[] = {
+            "unknown command",
+            "incomplete command",
+            "extra arguments after",
+            "unknown network command",
+            "unknown device command",
+            "expected one device name after",
+            "expected two ports after",
+            "expected strength, device and ports after",
+            "expected device and port after"
+        };
+
+        return messages[m];
+    }
+
+
+    /**
+     * Number identifying the script's name ids: scripts with the same id
+     * give every name they share the same id. A new script has an id of
+     * its own; linesIs gives a script the id of its source.
+     */
+    U64 id() const {
+        return id_;
+    }
+
+    /** Number of lines compiled, including blank lines and comments. */
+    U32 lineCount() const {
+        return lineCount_;
+    }
+
+    const std::vector<Instruction>& instructions() const {
+        return instructions_;
+    }
+
+    const Operand& operand(const U32 i) const {
+        return operands_[i];
+    }
+
+    /** Token of an operand or error instruction. */
+    Token text(const U32 t) const {
+        const auto p = text_.data() + t;
+        const auto end = static_cast<const char*>(memchr(p, '\n', text_.size() - t));
+        return Token(p, size_t(end - p));
+    }
+
+
+    /** Number of distinct network and device names. */
+    U32 nameCount() const {
+        return U32(names_.size());
+    }
+
+    Token name(const U32 id) const {
+        return nameText(names_[id]);
+    }
+
+
+    U32 parameterCount() const {
+        return U32(parameters_.size());
+    }
+
+    /** Name of the given parameter, without the leading '$'. */
+    Token parameterName(const U32 i) const {
+        return nameText(parameters_[i]).substr(1);
+    }
+
+
+    /**
+     * Compile lines from p until end or until the given number of lines,
+     * appending them to this script. Returns the start of the first line
+     * not compiled.
+     */
+    _noinline
+    const char* compile(const char* p, const char* const end, const U32 maxLines) {
+        for (U32 n = 0; p < end && n < maxLines; ++n) {
+            auto eol = static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+            if (eol == null) {
+                eol = end;
+            }
+
+            ++lineCount_;
+            tokenize(p, eol);
+            if (!tokens_.empty() && tokens_[0][0] != '#') {
+                lineNew();
+            }
+
+            p = eol + 1;
+        }
+
+        return p < end ? p : end;
+    }
+
+    /**
+     * Remove every line, keeping the names and parameters with their ids,
+     * and the storage for reuse.
+     */
+    void linesDel() {
+        lineCount_ = 0;
+        text_.clear();
+        operands_.clear();
+        instructions_.clear();
+    }
+
+    /**
+     * Take the lines of the given script, which is left with no lines
+     * and this script's storage for them, and copy the names and parameters
+     * it gained since the last call so their ids stay valid here. Each call
+     * copies only new names, so one script can compile a stream a block
+     * at a time and hand the blocks to others, as MalwareSim::evalStream
+     * does.
+     */
+    void linesIs(MalwareScript& source) {
+        std::swap(lineCount_, source.lineCount_);
+        text_.swap(source.text_);
+        operands_.swap(source.operands_);
+        instructions_.swap(source.instructions_);
+        source.linesDel();
+
+        if (id_ != source.id_) {
+            id_ = source.id_;
+            nameText_.clear();
+            names_.clear();
+            parameters_.clear();
+        }
+
+        // Names are only appended, so this script's are a prefix of
+        // the source's, at the same offsets.
+        nameText_.append(source.nameText_, nameText_.size(), string::npos);
+        names_.insert(names_.end(), source.names_.begin() + names_.size(),
+            source.names_.end()
+        );
+        parameters_.insert(parameters_.end(),
+            source.parameters_.begin() + parameters_.size(),
+            source.parameters_.end()
+        );
+
+        // Rebuilt from the ids if this script compiles lines itself.
+        nameTable_.clear();
+        parameterTable_.clear();
+    }
+
+
+    /**
+     * Read a script written by fileWrite for text with the given hash.
+     * Returns null if the file is missing, damaged, or for other text.
+     */
+    _noinline
+    static Ptr<MalwareScript> fileRead(const string& path, const U64 hash) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input.good()) {
+            return null;
+        }
+
+        Header header;
+        input.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!input.good() || std::memcmp(header.magic, magic, 4) != 0 ||
+            header.version != version || header.hash != hash
+        ) {
+            return null;
+        }
+
+        const Ptr<MalwareScript> script = new MalwareScript();
+        script->lineCount_ = header.lineCount;
+        script->nameText_.resize(header.nameTextSize);
+        script->text_.resize(header.textSize);
+        script->names_.resize(header.nameCount);
+        script->parameters_.resize(header.parameterCount);
+        script->operands_.resize(header.operandCount);
+        script->instructions_.resize(header.instructionCount);
+
+        if (!read(input, script->nameText_) || !read(input, script->text_) ||
+            !read(input, script->names_) || !read(input, script->parameters_) ||
+            !read(input, script->operands_) || !read(input, script->instructions_) ||
+            !script->valid()
+        ) {
+            return null;
+        }
+
+        return script;
+    }
+
+    /** Write this script, compiled from text with the given hash. */
+    _noinline
+    bool fileWrite(const string& path, const U64 hash) const {
+        Header header;
+        std::memcpy(header.magic, magic, 4);
+        header.version = version;
+        header.hash = hash;
+        header.lineCount = lineCount_;
+        header.nameTextSize = U32(nameText_.size());
+        header.textSize = U32(text_.size());
+        header.nameCount = U32(names_.size());
+        header.parameterCount = U32(parameters_.size());
+        header.operandCount = U32(operands_.size());
+        header.instructionCount = U32(instructions_.size());
+
+        // Write to a temporary file and rename it, so a reader never sees
+        // a partly written script.
+        const auto temporary = path + ".tmp";
+        {
+            std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+            output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            write(output, nameText_);
+            write(output, text_);
+            write(output, names_);
+            write(output, parameters_);
+            write(output, operands_);
+            write(output, instructions_);
+            if (!output.good()) {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+
+    MalwareScript(const MalwareScript&) = delete;
+
+    void operator =(const MalwareScript&) = delete;
+
+private:
+
+    enum Keyword {
+        unknown,
+        network,
+        device,
+        networkNewKeyword,
+        personalNewKeyword,
+        mobileNewKeyword,
+        firewallNewKeyword,
+        cloneAllKeyword,
+        infectionIsKeyword,
+        infectedDelKeyword,
+        ratingIsKeyword,
+        connectionIsKeyword,
+        cloneKeyword
+    };
+
+
+    /**
+     * Open-addressed hash table from keyword to keyword id, built once.
+     * The table is sparse enough that a lookup nearly always costs
+     * one hash and one comparison.
+     */
+    class KeywordTable {
+    public:
+
+        KeywordTable() {
+            keywordIs("Network", network);
+            keywordIs("Device", device);
+            keywordIs("networkNew", networkNewKeyword);
+            keywordIs("personalNew", personalNewKeyword);
+            keywordIs("mobileNew", mobileNewKeyword);
+            keywordIs("firewallNew", firewallNewKeyword);
+            keywordIs("cloneAll", cloneAllKeyword);
+            keywordIs("infectionIs", infectionIsKeyword);
+            keywordIs("infectedDel", infectedDelKeyword);
+            keywordIs("ratingIs", ratingIsKeyword);
+            keywordIs("connectionIs", connectionIsKeyword);
+            keywordIs("clone", cloneKeyword);
+        }
+
+        Keyword keyword(const Token token) const {
+            for (auto i = keywordHash(token);; ++i) {
+                const auto& entry = entries_[i % entryCount];
+                if (entry.keyword == unknown || entry.name == token) {
+                    return entry.keyword;
+                }
+            }
+        }
+
+    private:
+
+        static const U32 entryCount = 64;
+
+        struct Entry {
+            Token name;
+            Keyword keyword = unknown;
+        };
+
+        Entry entries_[entryCount];
+
+
+        void keywordIs(const Token name, const Keyword keyword) {
+            auto i = keywordHash(name);
+            while (entries_[i % entryCount].keyword != unknown) {
+                ++i;
+            }
+
+            entries_[i % entryCount].name = name;
+            entries_[i % entryCount].keyword = keyword;
+        }
+
+    };
+
+
+    /** Fixed-size start of a script file. */
+    struct Header {
+        char magic[4];
+        U32 version;
+        U64 hash;
+        U32 lineCount;
+        U32 nameTextSize;
+        U32 textSize;
+        U32 nameCount;
+        U32 parameterCount;
+        U32 operandCount;
+        U32 instructionCount;
+    };
+
+    static constexpr char magic[4] = { 'M', 'S', 'B', 'C' };
+
+    /** Format version, changed whenever Header, Operand or Instruction do. */
+    static const U32 version = 1;
+
+
+    static U64 instanceCount_;
+
+
+    U64 id_;
+    U32 lineCount_;
+
+    /** Text of the names and parameters. */
+    string nameText_;
+    std::vector<Text> names_;
+    std::vector<Text> parameters_;
+
+    /** Text of the operands and error tokens. */
+    string text_;
+    std::vector<Operand> operands_;
+    std::vector<Instruction> instructions_;
+
+    // Used while compiling. The tables hash names and parameters to ids,
+    // and are rebuilt from the ids when they grow.
+    std::vector<Token> tokens_;
+    std::vector<U32> nameTable_;
+    std::vector<U32> parameterTable_;
+
+
+    MalwareScript() :
+        id_(++instanceCount_),
+        lineCount_(0)
+    {
+        // Nothing else to do.
+    }
+
+    ~MalwareScript() {
+        // Nothing to do.
+    }
+
+
+    /**
+     * Hash of a keyword from its length and end characters, which tell
+     * every keyword apart. Tokens are never empty.
+     */
+    static U32 keywordHash(const Token token) {
+        return U32(token.size()) * 7 + U8(token.front()) * 3 + U8(token.back());
+    }
+
+    /** FNV-1a hash of a token. */
+    static U32 hash(const Token token) {
+        U32 h = 2166136261u;
+        for (const auto c : token) {
+            h = (h ^ U8(c)) * 16777619u;
+        }
+
+        return h;
+    }
+
+    static Keyword keyword(const Token token) {
+        static const KeywordTable keywords;
+        return keywords.keyword(token);
+    }
+
+    static bool isSpace(const char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+
+    void tokenize(const char* p, const char* const end) {
+        tokens_.clear();
+
+        for (;;) {
+            while (p < end && isSpace(*p)) {
+                ++p;
+            }
+
+            if (p == end) {
+                return;
+            }
+
+            const auto start = p;
+            while (p < end && !isSpace(*p)) {
+                ++p;
+            }
+
+            tokens_.emplace_back(start, size_t(p - start));
+        }
+    }
+
+    /** Append a token to the text, ended by a newline. */
+    U32 textNew(const Token token) {
+        const auto t = U32(text_.size());
+        text_.append(token.data(), token.size());
+        text_.push_back('\n');
+        return t;
+    }
+
+    Token nameText(const Text t) const {
+        return Token(nameText_.data() + t.begin, t.size);
+    }
+
+    U32 nameId(const Token token) {
+        return internedId(token, names_, nameTable_);
+    }
+
+    U32 parameterId(const Token token) {
+        return internedId(token, parameters_, parameterTable_);
+    }
+
+    /**
+     * Id of the given name among texts, added if it is new. The table
+     * is open-addressed and at most half full; its entries are ids,
+     * so it stays valid as nameText_ grows.
+     */
+    U32 internedId(
+        const Token token, std::vector<Text>& texts, std::vector<U32>& table
+    ) {
+        if (2 * (texts.size() + 1) > table.size()) {
+            tableIs(texts, table, std::max<size_t>(64, 4 * texts.size()));
+        }
+
+        const auto mask = U32(table.size() - 1);
+        for (auto i = hash(token) & mask;; i = (i + 1) & mask) {
+            const auto id = table[i];
+            if (id == none) {
+                const Text t = { U32(nameText_.size()), U32(token.size()) };
+                nameText_.append(token.data(), token.size());
+
+                table[i] = U32(texts.size());
+                texts.push_back(t);
+                return table[i];
+            }
+
+            if (nameText(texts[id]) == token) {
+                return id;
+            }
+        }
+    }
+
+    /** Rebuild a table with at least the given number of entries. */
+    void tableIs(
+        const std::vector<Text>& texts, std::vector<U32>& table, const size_t size
+    ) {
+        size_t n = 1;
+        while (n < size) {
+            n *= 2;
+        }
+
+        table.assign(n, none);
+
+        const auto mask = U32(n - 1);
+        for (U32 id = 0; id < texts.size(); ++id) {
+            auto i = hash(nameText(texts[id])) & mask;
+            while (table[i] != none) {
+                i = (i + 1) & mask;
+            }
+
+            table[i] = id;
+        }
+    }
+
+    /** Append an operand for a number or port token. */
+    void operandNew(const Token token) {
+        Operand o;
+        o.value = 0;
+        o.text = textNew(token);
+        o.parameter = noParameter;
+        o.number = false;
+        o.port = false;
+
+        if (token.size() > 1 && token[0] == '$') {
+            o.parameter = parameterId(token);
+        } else {
+            const auto end = token.data() + token.size();
+
+            // A port is also a number, so the number is parsed only
+            // when the token is not a port.
+            U32 port;
+            const auto p = std::from_chars(token.data(), end, port);
+            if (p.ec == std::errc() && p.ptr == end) {
+                o.value = port;
+                o.port = true;
+                o.number = true;
+            } else {
+                double number = 0;
+                const auto n = std::from_chars(token.data(), end, number);
+                o.value = number;
+                o.number = n.ec == std::errc() && n.ptr == end;
+            }
+        }
+
+        operands_.push_back(o);
+    }
+
+
+    Instruction instructionNew(const Op op) {
+        Instruction in;
+        in.line = lineCount_;
+        in.op = op;
+        in.stage = immediate;
+        in.message = unknownCommand;
+        in.token = none;
+        in.network = none;
+        in.device = none;
+        in.device2 = none;
+        in.operandBegin = U32(operands_.size());
+        in.operandEnd = in.operandBegin;
+        return in;
+    }
+
+    void errorNew(Instruction& in, const Message message, const Token token) {
+        in.op = error;
+        in.message = message;
+        in.token = textNew(token);
+        in.operandEnd = U32(operands_.size());
+        instructions_.push_back(in);
+    }
+
+    void instructionIs(Instruction& in, const Op op) {
+        in.op = op;
+        in.operandEnd = U32(operands_.size());
+        instructions_.push_back(in);
+    }
+
+
+    /** Compile the tokens of one command line. */
+    void lineNew() {
+        const auto& t = tokens_;
+        auto in = instructionNew(error);
+
+        switch (keyword(t[0])) {
+        case network:
+            networkLineNew(in);
+            break;
+
+        case device:
+            deviceLineNew(in);
+            break;
+
+        default:
+            errorNew(in, unknownCommand, t[0]);
+            break;
+        }
+    }
+
+    void networkLineNew(Instruction& in) {
+        const auto& t = tokens_;
+        if (t.size() < 3) {
+            errorNew(in, incompleteCommand, t[0]);
+            return;
+        }
+
+        if (keyword(t[1]) == networkNewKeyword) {
+            if (t.size() != 3) {
+                errorNew(in, extraArguments, t[2]);
+                return;
+            }
+
+            in.network = nameId(t[2]);
+            instructionIs(in, networkNew);
+            return;
+        }
+
+        in.network = nameId(t[1]);
+        in.stage = afterNetwork;
+
+        switch (keyword(t[2])) {
+        case personalNewKeyword:
+        case mobileNewKeyword:
+        case firewallNewKeyword: {
+            if (t.size() != 4) {
+                errorNew(in, expectedDeviceName, t[2]);
+                return;
+            }
+
+            const auto k = keyword(t[2]);
+            in.device = nameId(t[3]);
+            instructionIs(
+                in, k == personalNewKeyword ? personalNew :
+                    (k == mobileNewKeyword ? mobileNew : firewallNew)
+            );
+            break;
+        }
+
+        case cloneAllKeyword:
+            if (t.size() != 5) {
+                errorNew(in, expectedTwoPorts, t[2]);
+                return;
+            }
+
+            operandNew(t[3]);
+            operandNew(t[4]);
+            instructionIs(in, cloneAll);
+            break;
+
+        case infectionIsKeyword:
+            if (t.size() < 6) {
+                errorNew(in, expectedInfection, t[2]);
+                return;
+            }
+
+            in.device = nameId(t[4]);
+            operandNew(t[3]);
+            for (size_t i = 5; i < t.size(); ++i) {
+                operandNew(t[i]);
+            }
+            instructionIs(in, infectionIs);
+            break;
+
+        case infectedDelKeyword:
+            if (t.size() != 3) {
+                errorNew(in, extraArguments, t[2]);
+                return;
+            }
+
+            instructionIs(in, infectedDel);
+            break;
+
+        default:
+            errorNew(in, unknownNetworkCommand, t[2]);
+            break;
+        }
+    }
+
+    void deviceLineNew(Instruction& in) {
+        const auto& t = tokens_;
+        if (t.size() < 6) {
+            errorNew(in, incompleteCommand, t[0]);
+            return;
+        }
+
+        in.network = nameId(t[1]);
+        in.device = nameId(t[2]);
+        in.stage = afterPort;
+        operandNew(t[3]);
+
+        switch (keyword(t[4])) {
+        case ratingIsKeyword:
+            if (t.size() != 6) {
+                errorNew(in, extraArguments, t[5]);
+                return;
+            }
+
+            operandNew(t[5]);
+            instructionIs(in, ratingIs);
+            break;
+
+        case connectionIsKeyword:
+        case cloneKeyword:
+            if (t.size() != 7) {
+                errorNew(in, expectedDevicePort, t[4]);
+                return;
+            }
+
+            in.device2 = nameId(t[5]);
+            operandNew(t[6]);
+            instructionIs(
+                in, keyword(t[4]) == connectionIsKeyword ? connectionIs : clone
+            );
+            break;
+
+        default:
+            errorNew(in, unknownDeviceCommand, t[4]);
+            break;
+        }
+    }
+
+
+    /** Flag indicating whether every index in the script is in range. */
+    bool valid() const {
+        // Every token ends with a newline, the last character of the text.
+        const auto inText = [this](const U32 t) {
+            return t < text_.size() && text_.back() == '\n';
+        };
+        const auto inNameText = [this](const Text t) {
+            return t.begin <= nameText_.size() &&
+                t.size <= nameText_.size() - t.begin;
+        };
+        const auto inNames = [this](const U32 id) {
+            return id == none || id < names_.size();
+        };
+
+        for (const auto& t : names_) {
+            if (!inNameText(t)) {
+                return false;
+            }
+        }
+
+        for (const auto& t : parameters_) {
+            if (!inNameText(t) || t.size < 2) {
+                return false;
+            }
+        }
+
+        for (const auto& o : operands_) {
+            if (!inText(o.text) ||
+                (o.parameter != noParameter && o.parameter >= parameters_.size())
+            ) {
+                return false;
+            }
+        }
+
+        for (const auto& in : instructions_) {
+            if (in.op > clone || in.stage > afterPort ||
+                in.message > expectedDevicePort ||
+                (in.token != none && !inText(in.token)) ||
+                !inNames(in.network) || !inNames(in.device) ||
+                !inNames(in.device2) ||
+                in.operandBegin > in.operandEnd || in.operandEnd > operands_.size()
+            ) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /** Read the contents of a string or vector already sized to hold them. */
+    template <class T>
+    static bool read(std::istream& input, T& v) {
+        input.read(
+            reinterpret_cast<char*>(v.data()),
+            std::streamsize(v.size() * sizeof(v[0]))
+        );
+        return input.good();
+    }
+
+    template <class T>
+    static void write(std::ostream& output, const T& v) {
+        output.write(
+            reinterpret_cast<const char*>(v.data()),
+            std::streamsize(v.size() * sizeof(v[0]))
+        );
+    }
+
+};
+
+U64 MalwareScript::instanceCount_ = 0;
+
+#endif
@@ -0,0 +1,1167 @@
+/**
+ * Interpreter for Malware Simulation scripts.
+ */
+
+#ifndef MALWARESIM_H
+#define MALWARESIM_H
+
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _MSC_VER
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+using fwk::Ptr;
+
+/**
+ * MalwareSim executes a script of commands, one per line:
+ *
+ *     Network networkNew N
+ *     Network N personalNew D
+ *     Network N mobileNew D
+ *     Network N firewallNew D
+ *     Network N cloneAll p1 p2
+ *     Network N infectionIs s D p1 ... pk
+ *     Network N infectedDel
+ *     Device N D p ratingIs r
+ *     Device N D p connectionIs D2 p2
+ *     Device N D p clone D2 p2
+ *
+ * Blank lines and lines starting with '#' are ignored. An invalid command
+ * is reported on the error stream with its line number and skipped.
+ *
+ * cloneAll clones every device D in the network as D-clone (or D-clone-2,
+ * D-clone-3, ... if the name is in use) and connects port p1 of D to port p2
+ * of its clone. clone does the same for one device with the given name.
+ *
+ * infectionIs follows the route p1 ... p(k-1) from D through connected ports
+ * and lets malware of strength s in on port pk of the device reached.
+ * It then prints six counts: infected devices, healthy devices, devices
+ * newly infected by this command, personal devices, network devices, and
+ * links between an infected and a healthy device.
+ *
+ * infectedDel disconnects and removes every infected device.
+ *
+ * A port or number written as $name is a parameter, taking the value last
+ * given to parameterIs for that name when the command runs.
+ *
+ * Scripts run in their compiled form (MalwareScript). evalBuffer compiles
+ * and runs a buffer a block of lines at a time; evalStream does the same
+ * with the compiling on a second thread. A script compiled once with
+ * scriptNew can be run any number of times with eval, for instance over
+ * a sweep of parameter values. With a cache directory, scriptNew
+ * and evalFile keep compiled scripts there, keyed by a hash of the text,
+ * so a script read again is not compiled again.
+ *
+ * With shardCountIs, networkNew creates ShardedNetworks instead, whose
+ * shards apply commands on their own threads while the script goes on.
+ * Each command is checked against the devices the ShardedNetwork knows
+ * on the calling thread, so errors are reported by line as usual;
+ * a command a shard still rejects is counted, and reported once the
+ * script ends. A sharded network supports everything but routes
+ * in infectionIs, cloneAll and clone, which are reported as errors.
+ * infectionIs waits for the shards, to print its counts.
+ *
+ * Notifiees hear of each ordinary Network networkNew creates, before
+ * any command uses it, e.g. to attach a NetworkJournal.
+ */
+class MalwareSim : public fwk::PtrInterface {
+public:
+
+    class Notifiee : public BaseNotifiee<MalwareSim> {
+    public:
+
+        void notifierIs(const Ptr<MalwareSim>& sim) {
+            connect(sim, this);
+        }
+
+
+        /** Notification that networkNew created the given network. */
+        virtual void onNetworkNew(const Ptr<Network>& network) { }
+
+    };
+
+    typedef std::list<Notifiee*> NotifieeList;
+
+
+    static Ptr<MalwareSim> instanceNew(
+        std::ostream& output = std::cout, std::ostream& errors = std::cerr
+    ) {
+        return new MalwareSim(output, errors);
+    }
+
+
+    /** Number of commands executed, including those that failed. */
+    U64 commandCount() const {
+        return commandCount_;
+    }
+
+    /** Number of commands that reported an error. */
+    U64 errorCount() const {
+        return errorCount_;
+    }
+
+
+    /** Value of the named parameter, or NaN if it is not bound. */
+    double parameter(const string& name) const {
+        const auto i = parameters_.find(name);
+        return i == parameters_.end() ? std::nan("") : i->second;
+    }
+
+    void parameterIs(const string& name, const double value) {
+        parameters_[name] = value;
+    }
+
+    void parameterDel(const string& name) {
+        parameters_.erase(name);
+    }
+
+
+    /**
+     * Number of shards of each network networkNew creates from now on,
+     * or 0, the default, for an ordinary Network.
+     */
+    U32 shardCount() const {
+        return shardCount_;
+    }
+
+    void shardCountIs(const U32 shardCount) {
+        shardCount_ = shardCount;
+    }
+
+
+    /** Directory of compiled scripts, or empty if there is no cache. */
+    const string& cacheDirectory() const {
+        return cacheDirectory_;
+    }
+
+    void cacheDirectoryIs(const string& directory) {
+        cacheDirectory_ = directory;
+    }
+
+
+    /**
+     * Return the script compiled from the given text, read from the cache
+     * directory if it holds it, and added to it otherwise.
+     */
+    _noinline
+    Ptr<MalwareScript> scriptNew(const char* const data, const size_t size) {
+        if (cacheDirectory_.empty()) {
+            return MalwareScript::instanceNew(data, size);
+        }
+
+        const auto hash = MalwareScript::textHash(data, size);
+        const auto path = cachePath(hash);
+
+        auto script = MalwareScript::fileRead(path, hash);
+        if (script == null) {
+            script = MalwareScript::instanceNew(data, size);
+            script->fileWrite(path, hash);
+        }
+
+        return script;
+    }
+
+    /**
+     * Return the script compiled from the named file, or null if the file
+     * cannot be opened.
+     */
+    Ptr<MalwareScript> scriptFileNew(const string& path) {
+        Ptr<MalwareScript> script;
+        const bool ok = fileRead(
+            path, [this, &script](const char* data, size_t size) {
+                script = scriptNew(data, size);
+            }
+        );
+
+        return ok ? script : null;
+    }
+
+
+    /**
+     * Execute the given stream as it is read. A reader thread compiles
+     * the stream a block of lines at a time and passes the blocks through
+     * a ring to this thread, which runs them in order, so reading and
+     * parsing overlap execution while commands still run one at a time.
+     */
+    _noinline
+    void evalStream(std::istream& input) {
+        BlockRing ready;
+        BlockRing free;
+
+        Ptr<MalwareScript> blocks[streamBlockCount];
+        for (auto& b : blocks) {
+            b = MalwareScript::instanceNew();
+            free.push(b.ptr());
+        }
+
+        // Only the reader touches the source, and each block is touched
+        // by one thread at a time, as the rings hand it over.
+        const auto source = MalwareScript::instanceNew();
+        std::exception_ptr failure;
+        std::thread reader([&input, &source, &ready, &free, &failure]() {
+            try {
+                compileStream(input, *source.ptr(), ready, free);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+
+            ready.push(null);
+        });
+
+        try {
+            for (auto b = ready.pop(); b != null; b = ready.pop()) {
+                run(*b);
+                free.push(b);
+            }
+        } catch (...) {
+            for (auto b = ready.pop(); b != null; b = ready.pop()) {
+                free.push(b);
+            }
+
+            reader.join();
+            throw;
+        }
+
+        reader.join();
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+
+        shardErrorsOut();
+    }
+
+    /**
+     * Execute the named file, through the cache directory if there is one.
+     * Returns false if the file cannot be opened.
+     */
+    bool evalFile(const string& path) {
+        if (!cacheDirectory_.empty()) {
+            const auto script = scriptFileNew(path);
+            if (script == null) {
+                return false;
+            }
+
+            eval(script);
+            return true;
+        }
+
+        return fileRead(path, [this](const char* data, size_t size) {
+            evalBuffer(data, size);
+        });
+    }
+
+    /** Execute the script in the given buffer. */
+    _noinline
+    void evalBuffer(const char* const data, const size_t size) {
+        const char* p = data;
+        const char* const end = data + size;
+
+        while (p < end) {
+            block_->linesDel();
+            p = block_->compile(p, end, blockLineCount);
+            run(*block_.ptr());
+        }
+
+        shardErrorsOut();
+    }
+
+    /** Execute a compiled script, continuing the line count. */
+    void eval(const Ptr<MalwareScript>& script) {
+        run(*script.ptr());
+        shardErrorsOut();
+    }
+
+
+    NotifieeList& notifiees() {
+        return notifiees_;
+    }
+
+    /** Name that traced notifications from the interpreter carry. */
+    string name() const {
+        return "MalwareSim";
+    }
+
+
+    MalwareSim(const MalwareSim&) = delete;
+
+    void operator =(const MalwareSim&) = delete;
+
+private:
+
+    typedef std::string_view Token;
+
+    typedef MalwareScript::Instruction Instruction;
+    typedef MalwareScript::Operand Operand;
+
+    /** Lines evalBuffer and evalStream compile at a time. */
+    static const U32 blockLineCount = 1024;
+
+    /** Blocks evalStream has in flight, and the bytes it reads at a time. */
+    static const U32 streamBlockCount = 4;
+    static const U32 streamReadSize = 1 << 16;
+
+    /** Blocks passed between evalStream's threads; null ends the stream. */
+    typedef RingBuffer<MalwareScript*, 2 * streamBlockCount> BlockRing;
+
+    /** A device name resolved to its network and id (Network::device(U32)). */
+    struct DeviceHandle {
+        Network* network = null;
+        U32 id = 0;
+    };
+
+    /** Networks by name; a key views the name of its network. */
+    typedef std::unordered_map< Token, Ptr<Network> > NetworkMap;
+
+    /** A sharded network, its name, and its shard errors reported so far. */
+    struct Sharded {
+        string name;
+        Ptr<ShardedNetwork> network;
+        U64 errorCount;
+    };
+
+    /** Sharded networks by name; a key views Sharded::name. */
+    typedef std::unordered_map< Token, std::unique_ptr<Sharded> > ShardedMap;
+
+    /**
+     * Counts of the personal and network devices in a network, kept
+     * as devices are added and removed so that infectionIs need not walk
+     * the devices. Unlike NetworkTracker, it watches no device.
+     */
+    class DeviceCounter : public Network::Notifiee {
+    public:
+
+        static Ptr<DeviceCounter> instanceNew(const Ptr<Network>& network) {
+            const Ptr<DeviceCounter> counter = new DeviceCounter();
+            counter->notifierIs(network);
+            return counter;
+        }
+
+        U64 personalCount() const {
+            return personalCount_;
+        }
+
+        U64 networkDeviceCount() const {
+            return networkDeviceCount_;
+        }
+
+        void onDeviceNew(const Ptr<Device>& device) {
+            ++count(device.ptr());
+        }
+
+        void onDeviceDel(const Ptr<Device>& device) {
+            --count(device.ptr());
+        }
+
+    private:
+
+        U64 personalCount_;
+        U64 networkDeviceCount_;
+        U64 otherCount_;
+
+        DeviceCounter() :
+            personalCount_(0),
+            networkDeviceCount_(0),
+            otherCount_(0)
+        {
+            // Nothing else to do.
+        }
+
+        U64& count(Device* const device) {
+            if (dynamic_cast<PersonalDevice*>(device) != null) {
+                return personalCount_;
+            }
+
+            if (dynamic_cast<NetworkDevice*>(device) != null) {
+                return networkDeviceCount_;
+            }
+
+            return otherCount_;
+        }
+    };
+
+
+    std::ostream& output_;
+    std::ostream& errors_;
+
+    NetworkMap networks_;
+    std::unordered_map< Network*, Ptr<DeviceCounter> > counters_;
+    ShardedMap shardedNetworks_;
+    U32 shardCount_;
+
+    NotifieeList notifiees_;
+
+    std::unordered_map<string, double> parameters_;
+    string cacheDirectory_;
+
+    /** Script reused by evalBuffer for each block of lines. */
+    Ptr<MalwareScript> block_;
+
+    // State of the script being run, indexed by its name and parameter ids.
+    // The slots are kept while the same script (MalwareScript::id) runs
+    // again, as the block of evalBuffer does, since its ids do not change.
+    U64 slotScript_;
+    std::vector< Ptr<Network> > networkSlots_;
+    std::vector<Sharded*> shardedSlots_;
+    std::vector<DeviceHandle> deviceSlots_;
+    std::vector<double> values_;
+
+    string key_;
+
+    U64 line_;
+    U64 commandCount_;
+    U64 errorCount_;
+
+
+    MalwareSim(std::ostream& output, std::ostream& errors) :
+        output_(output),
+        errors_(errors),
+        shardCount_(0),
+        block_(MalwareScript::instanceNew()),
+        slotScript_(0),
+        line_(0),
+        commandCount_(0),
+        errorCount_(0)
+    {
+        // Nothing else to do.
+    }
+
+    ~MalwareSim() {
+        for (auto& n : networks_) {
+            n.second->destroyedIsTrue();
+        }
+    }
+
+
+    /**
+     * Call f with the contents of the named file, mapping it into memory
+     * where possible. Returns false if the file cannot be opened.
+     */
+    template <class F>
+    _noinline
+    static bool fileRead(const string& path, const F& f) {
+#ifndef _MSC_VER
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            const auto size = size_t(info.st_size);
+            if (size == 0) {
+                ::close(fd);
+                f("", 0);
+                return true;
+            }
+
+            void* const data = mmap(null, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                ::close(fd);
+                madvise(data, size, MADV_SEQUENTIAL);
+
+                f(static_cast<const char*>(data), size);
+
+                munmap(data, size);
+                return true;
+            }
+        }
+
+        ::close(fd);
+#endif
+
+        std::ifstream input(path, std::ios::binary);
+        if (!input.good()) {
+            return false;
+        }
+
+        const string text(
+            (std::istreambuf_iterator<char>(input)),
+            std::istreambuf_iterator<char>()
+        );
+
+        f(text.data(), text.size());
+        return true;
+    }
+
+    /**
+     * Compile the stream into source, moving every blockLineCount lines
+     * into a block taken from free and passing it on through ready.
+     * Runs on evalStream's reader thread.
+     */
+    _noinline
+    static void compileStream(
+        std::istream& input, MalwareScript& source, BlockRing& ready,
+        BlockRing& free
+    ) {
+        const auto blockDone = [&source, &ready, &free]() {
+            const auto b = free.pop();
+            b->linesIs(source);
+            ready.push(b);
+        };
+
+        string buffer;
+        for (bool more = true; more;) {
+            const auto size = buffer.size();
+            buffer.resize(size + streamReadSize);
+            input.read(&buffer[size], streamReadSize);
+            buffer.resize(size + size_t(input.gcount()));
+            more = input.good();
+
+            // Compile whole lines, keeping a partial last line for the next
+            // read, until the stream ends.
+            auto n = buffer.size();
+            if (more) {
+                const auto eol = buffer.rfind('\n');
+                if (eol == string::npos) {
+                    continue;
+                }
+
+                n = eol + 1;
+            }
+
+            const char* p = buffer.data();
+            const char* const end = p + n;
+            while (p < end) {
+                p = source.compile(p, end, blockLineCount - source.lineCount());
+                if (source.lineCount() == blockLineCount) {
+                    blockDone();
+                }
+            }
+
+            buffer.erase(0, n);
+        }
+
+        if (source.lineCount() != 0) {
+            blockDone();
+        }
+    }
+
+    string cachePath(const U64 hash) const {
+        char name[24];
+        snprintf(name, sizeof(name), "%016llx.msc", (unsigned long long) hash);
+        return cacheDirectory_ + "/" + name;
+    }
+
+
+    void error(const char* const message, const Token token) {
+        ++errorCount_;
+        errors_ << "line " << line_ << ": " << message << " '" << token << "'\n";
+    }
+
+    /** String copy of the given token, reusing one buffer. */
+    const string& key(const Token token) {
+        key_.assign(token.data(), token.size());
+        return key_;
+    }
+
+
+    _noinline
+    void run(const MalwareScript& script) {
+        if (script.id() != slotScript_) {
+            slotScript_ = script.id();
+            networkSlots_.clear();
+            shardedSlots_.clear();
+            deviceSlots_.clear();
+        }
+
+        networkSlots_.resize(script.nameCount());
+        shardedSlots_.resize(script.nameCount(), null);
+        deviceSlots_.resize(script.nameCount());
+
+        values_.resize(script.parameterCount());
+        for (U32 i = 0; i < script.parameterCount(); ++i) {
+            values_[i] = parameter(string(script.parameterName(i)));
+        }
+
+        const auto base = line_;
+        for (const auto& in : script.instructions()) {
+            line_ = base + in.line;
+            ++commandCount_;
+
+            try {
+                eval(script, in);
+            } catch (const fwk::Exception& e) {
+                error("failed", e.what());
+            } catch (const std::exception& e) {
+                error("failed", e.what());
+            }
+        }
+
+        line_ = base + script.lineCount();
+    }
+
+    /**
+     * Execute one instruction. The checks run in the order the command's
+     * arguments appear, so an error instruction first looks up what
+     * precedes its mistake (MalwareScript::Stage).
+     */
+    void eval(const MalwareScript& s, const Instruction& in) {
+        if (in.op == MalwareScript::networkNew) {
+            networkNew(s, in);
+            return;
+        }
+
+        if (in.op == MalwareScript::error && in.stage == MalwareScript::immediate) {
+            error(MalwareScript::message(in.message), s.text(in.token));
+            return;
+        }
+
+        if (!shardedNetworks_.empty()) {
+            if (const auto sharded = shardedFor(s, in.network)) {
+                evalSharded(s, in, *sharded->network.ptr());
+                return;
+            }
+        }
+
+        const auto n = networkFor(s, in.network);
+        if (n == null) {
+            return;
+        }
+
+        switch (in.op) {
+        case MalwareScript::personalNew:
+        case MalwareScript::mobileNew:
+        case MalwareScript::firewallNew:
+            deviceNew(s, in, n);
+            break;
+
+        case MalwareScript::cloneAll:
+            cloneAllNew(s, in, n);
+            break;
+
+        case MalwareScript::infectionIs:
+            infectionNew(s, in, n);
+            break;
+
+        case MalwareScript::infectedDel:
+            n->infectedDel();
+            break;
+
+        default:
+            if (in.stage == MalwareScript::afterNetwork) {
+                error(MalwareScript::message(in.message), s.text(in.token));
+            } else {
+                evalDevice(s, in, n);
+            }
+            break;
+        }
+    }
+
+    void evalDevice(
+        const MalwareScript& s, const Instruction& in, const Ptr<Network>& n
+    ) {
+        const auto d = deviceFor(s, n, in.device);
+        if (d == null) {
+            return;
+        }
+
+        U32 p;
+        if (!portFor(s, d, in.operandBegin, p)) {
+            return;
+        }
+
+        switch (in.op) {
+        case MalwareScript::ratingIs: {
+            double value;
+            if (!numberFor(s, in.operandBegin + 1, value)) {
+                return;
+            }
+
+            const auto rating = MalwareStrength::tryMake(value);
+            if (!rating.ok()) {
+                const auto& o = s.operand(in.operandBegin + 1);
+                error("rating out of range 0..1", s.text(o.text));
+                return;
+            }
+
+            d->portRatingIs(p, rating.value());
+            break;
+        }
+
+        case MalwareScript::connectionIs: {
+            const auto d2 = deviceFor(s, n, in.device2);
+            U32 p2;
+            if (d2 == null || !portFor(s, d2, in.operandBegin + 1, p2)) {
+                return;
+            }
+
+            d->connectionIs(p, d2, p2);
+            break;
+        }
+
+        case MalwareScript::clone: {
+            const auto name = s.name(in.device2);
+            if (n->device(name) != null) {
+                error("device already exists", name);
+                return;
+            }
+
+            U32 p2;
+            if (!portFor(s, d, in.operandBegin + 1, p2)) {
+                return;
+            }
+
+            const auto d2 = d->cloneNew(key(name));
+            n->deviceIs(d2);
+            d->connectionIs(p, d2, p2);
+            break;
+        }
+
+        default:
+            error(MalwareScript::message(in.message), s.text(in.token));
+            break;
+        }
+    }
+
+
+    /** Network with the given name id, found once per run of a script. */
+    Ptr<Network> networkFor(const MalwareScript& s, const U32 id) {
+        auto& slot = networkSlots_[id];
+        if (slot != null) {
+            return slot;
+        }
+
+        const auto i = networks_.find(s.name(id));
+        if (i == networks_.end()) {
+            error("unknown network", s.name(id));
+            return null;
+        }
+
+        slot = i->second;
+        return slot;
+    }
+
+    /**
+     * Device with the given name id. A name is resolved to a handle once
+     * and the handle reused on later lines; it is checked against
+     * the device's name, so handles stale after a bulk removal, or for
+     * a device of the same name in another network, fall back to
+     * the name lookup.
+     */
+    Ptr<Device> deviceFor(
+        const MalwareScript& s, const Ptr<Network>& n, const U32 id
+    ) {
+        const auto name = s.name(id);
+
+        auto& handle = deviceSlots_[id];
+        if (handle.network == n.ptr()) {
+            const auto d = n->device(handle.id);
+            if (d != null && d->name() == name) {
+                return d;
+            }
+        }
+
+        const auto d = n->device(name);
+        if (d == null) {
+            error("unknown device", name);
+            return null;
+        }
+
+        handle.network = n.ptr();
+        handle.id = d->id();
+        return d;
+    }
+
+    /**
+     * Value of the given operand, with flags for whether it is a valid
+     * port and number. Returns false if it names an unbound parameter.
+     */
+    bool valueFor(
+        const MalwareScript& s, const Operand& o, double& value, bool& port,
+        bool& number
+    ) {
+        if (o.parameter == MalwareScript::noParameter) {
+            value = o.value;
+            port = o.port;
+            number = o.number;
+            return true;
+        }
+
+        value = values_[o.parameter];
+        if (std::isnan(value)) {
+            error("unbound parameter", s.text(o.text));
+            return false;
+        }
+
+        port = value >= 0 && value <= 4294967295.0 && value == std::floor(value);
+        number = true;
+        return true;
+    }
+
+    bool portFor(
+        const MalwareScript& s, const Ptr<Device>& d, const U32 i, U32& port
+    ) {
+        return portFor(s, U32(d->portCount()), i, port);
+    }
+
+    bool portFor(
+        const MalwareScript& s, const U32 portCount, const U32 i, U32& port
+    ) {
+        const auto& o = s.operand(i);
+
+        double value;
+        bool isPort, isNumber;
+        if (!valueFor(s, o, value, isPort, isNumber)) {
+            return false;
+        }
+
+        if (!isPort) {
+            error("invalid port", s.text(o.text));
+            return false;
+        }
+
+        port = U32(value);
+        if (port >= portCount) {
+            error("port out of range", s.text(o.text));
+            return false;
+        }
+
+        return true;
+    }
+
+    bool numberFor(const MalwareScript& s, const U32 i, double& value) {
+        const auto& o = s.operand(i);
+
+        bool isPort, isNumber;
+        if (!valueFor(s, o, value, isPort, isNumber)) {
+            return false;
+        }
+
+        if (!isNumber) {
+            error("invalid number", s.text(o.text));
+            return false;
+        }
+
+        return true;
+    }
+
+
+    void networkNew(const MalwareScript& s, const Instruction& in) {
+        const auto name = s.name(in.network);
+        if (networks_.find(name) != networks_.end() ||
+            shardedNetworks_.find(name) != shardedNetworks_.end()
+        ) {
+            error("network already exists", name);
+            return;
+        }
+
+        if (shardCount_ != 0) {
+            std::unique_ptr<Sharded> sharded(new Sharded{
+                key(name), ShardedNetwork::instanceNew(key(name), shardCount_), 0
+            });
+            shardedSlots_[in.network] = sharded.get();
+            const Token token = sharded->name;
+            shardedNetworks_.emplace(token, std::move(sharded));
+            return;
+        }
+
+        const auto n = Network::instanceNew(key(name));
+        networks_.emplace(n->name(), n);
+        counters_.emplace(n.ptr(), DeviceCounter::instanceNew(n));
+        networkSlots_[in.network] = n;
+
+        post(this, &Notifiee::onNetworkNew, n);
+    }
+
+    void deviceNew(
+        const MalwareScript& s, const Instruction& in, const Ptr<Network>& n
+    ) {
+        const auto name = s.name(in.device);
+        if (n->device(name) != null) {
+            error("device already exists", name);
+            return;
+        }
+
+        if (in.op == MalwareScript::personalNew) {
+            n->deviceIs(PersonalDevice::instanceNew(key(name)));
+        } else if (in.op == MalwareScript::mobileNew) {
+            n->deviceIs(MobileDevice::instanceNew(key(name)));
+        } else {
+            n->deviceIs(FirewallDevice::instanceNew(key(name)));
+        }
+    }
+
+    void cloneAllNew(
+        const MalwareScript& s, const Instruction& in, const Ptr<Network>& n
+    ) {
+        U32 p1, p2;
+        for (auto i = n->deviceIter(); i != n->deviceIterEnd(); ++i) {
+            if (!portFor(s, i->second, in.operandBegin, p1) ||
+                !portFor(s, i->second, in.operandBegin + 1, p2)
+            ) {
+                return;
+            }
+        }
+
+        if (n->deviceCount() != 0) {
+            n->cloneAllNew(p1, p2);
+        }
+    }
+
+    _noinline
+    void infectionNew(
+        const MalwareScript& s, const Instruction& in, const Ptr<Network>& n
+    ) {
+        double value;
+        if (!numberFor(s, in.operandBegin, value)) {
+            return;
+        }
+
+        const auto strength = MalwareStrength::tryMake(value);
+        if (!strength.ok()) {
+            const auto& o = s.operand(in.operandBegin);
+            error("strength out of range 0..1", s.text(o.text));
+            return;
+        }
+
+        auto d = deviceFor(s, n, in.device);
+        if (d == null) {
+            return;
+        }
+
+        U32 p;
+        const auto last = in.operandEnd - 1;
+        for (auto i = in.operandBegin + 1; i < last; ++i) {
+            if (!portFor(s, d, i, p)) {
+                return;
+            }
+
+            if (d->otherDevice(p) == null) {
+                error("route reaches unconnected port", s.text(s.operand(i).text));
+                return;
+            }
+
+            d = d->otherDevice(p);
+        }
+
+        if (!portFor(s, d, last, p)) {
+            return;
+        }
+
+        const U64 before = n->infectedCount();
+        n->infectionIs(strength.value(), d, p);
+        statsOut(n, before);
+    }
+
+
+    /** Sharded network with the given name id, or null if there is none. */
+    Sharded* shardedFor(const MalwareScript& s, const U32 id) {
+        auto& slot = shardedSlots_[id];
+        if (slot == null) {
+            const auto i = shardedNetworks_.find(s.name(id));
+            if (i != shardedNetworks_.end()) {
+                slot = i->second.get();
+            }
+        }
+
+        return slot;
+    }
+
+    /**
+     * Ports of the device of a sharded network with the given name id,
+     * or 0, reported as an error, if there is no such device.
+     */
+    U32 shardedPortCount(
+        const MalwareScript& s, const ShardedNetwork& n, const U32 id
+    ) {
+        const auto name = s.name(id);
+        const auto count = n.portCount(key(name));
+        if (count == 0) {
+            error("unknown device", name);
+        }
+
+        return count;
+    }
+
+    /**
+     * Execute one instruction on a sharded network, with the checks
+     * of eval, evalDevice and infectionNew in the same order.
+     */
+    _noinline
+    void evalSharded(
+        const MalwareScript& s, const Instruction& in, ShardedNetwork& n
+    ) {
+        switch (in.op) {
+        case MalwareScript::personalNew:
+        case MalwareScript::mobileNew:
+        case MalwareScript::firewallNew: {
+            const auto name = s.name(in.device);
+            if (n.portCount(key(name)) != 0) {
+                error("device already exists", name);
+            } else if (in.op == MalwareScript::personalNew) {
+                n.personalNew(key_);
+            } else if (in.op == MalwareScript::mobileNew) {
+                n.mobileNew(key_);
+            } else {
+                n.firewallNew(key_);
+            }
+            return;
+        }
+
+        case MalwareScript::cloneAll:
+            error("not supported on a sharded network", s.name(in.network));
+            return;
+
+        case MalwareScript::infectionIs:
+            shardedInfectionNew(s, in, n);
+            return;
+
+        case MalwareScript::infectedDel:
+            n.infectedDel();
+            return;
+
+        default:
+            break;
+        }
+
+        if (in.stage == MalwareScript::afterNetwork) {
+            error(MalwareScript::message(in.message), s.text(in.token));
+            return;
+        }
+
+        const auto count = shardedPortCount(s, n, in.device);
+        U32 p;
+        if (count == 0 || !portFor(s, count, in.operandBegin, p)) {
+            return;
+        }
+
+        switch (in.op) {
+        case MalwareScript::ratingIs: {
+            double value;
+            if (!numberFor(s, in.operandBegin + 1, value)) {
+                return;
+            }
+
+            const auto rating = MalwareStrength::tryMake(value);
+            if (!rating.ok()) {
+                const auto& o = s.operand(in.operandBegin + 1);
+                error("rating out of range 0..1", s.text(o.text));
+                return;
+            }
+
+            n.portRatingIs(key(s.name(in.device)), p, rating.value());
+            break;
+        }
+
+        case MalwareScript::connectionIs: {
+            const auto count2 = shardedPortCount(s, n, in.device2);
+            U32 p2;
+            if (count2 == 0 || !portFor(s, count2, in.operandBegin + 1, p2)) {
+                return;
+            }
+
+            n.connectionIs(string(s.name(in.device)), p, key(s.name(in.device2)), p2);
+            break;
+        }
+
+        case MalwareScript::clone:
+            error("not supported on a sharded network", s.name(in.network));
+            break;
+
+        default:
+            error(MalwareScript::message(in.message), s.text(in.token));
+            break;
+        }
+    }
+
+    /** infectionNew on a sharded network, for an infection without a route. */
+    _noinline
+    void shardedInfectionNew(
+        const MalwareScript& s, const Instruction& in, ShardedNetwork& n
+    ) {
+        double value;
+        if (!numberFor(s, in.operandBegin, value)) {
+            return;
+        }
+
+        const auto strength = MalwareStrength::tryMake(value);
+        if (!strength.ok()) {
+            const auto& o = s.operand(in.operandBegin);
+            error("strength out of range 0..1", s.text(o.text));
+            return;
+        }
+
+        const auto count = shardedPortCount(s, n, in.device);
+        if (count == 0) {
+            return;
+        }
+
+        const auto last = in.operandEnd - 1;
+        if (in.operandBegin + 1 < last) {
+            const auto& o = s.operand(in.operandBegin + 1);
+            error("route not supported on a sharded network", s.text(o.text));
+            return;
+        }
+
+        U32 p;
+        if (!portFor(s, count, last, p)) {
+            return;
+        }
+
+        const U64 newlyInfected = n.infectionIs(strength.value(), key(s.name(in.device)), p);
+        const U64 infected = n.infectedCount();
+
+        output_ << infected << ' ' << n.deviceCount() - infected << ' ' <<
+            newlyInfected << ' ' << n.personalCount() << ' ' <<
+            n.networkDeviceCount() << ' ' << n.blockedLinkCount() << '\n';
+    }
+
+    /**
+     * Report the commands the shards of each sharded network rejected
+     * since the last report, waiting for the shards.
+     */
+    void shardErrorsOut() {
+        for (auto& i : shardedNetworks_) {
+            auto& sharded = *i.second;
+            const auto count = sharded.network->errorCount();
+            if (count != sharded.errorCount) {
+                errorCount_ += count - sharded.errorCount;
+                errors_ << "line " << line_ << ": " << count - sharded.errorCount <<
+                    " commands failed in the shards of '" << sharded.name << "'\n";
+                sharded.errorCount = count;
+            }
+        }
+    }
+
+
+    void statsOut(const Ptr<Network>& n, const U64 before) {
+        const auto& counter = counters_.at(n.ptr());
+        const auto personal = counter->personalCount();
+        const auto networkDevices = counter->networkDeviceCount();
+
+        const auto& table = n->portTable();
+
+        U64 blockedLinks = 0;
+        table.infectedEach([&blockedLinks, &table](const U32 id) {
+            const auto end = table.portBegin(id) + table.portCount(id);
+            for (auto r = table.portBegin(id); r < end; ++r) {
+                const auto peer = table.peer(r);
+                if (peer != PortTable::none && !table.infected(peer)) {
+                    ++blockedLinks;
+                }
+            }
+        });
+
+        const U64 infected = n->infectedCount();
+
+        output_ << infected << ' ' << n->deviceCount() - infected << ' ' <<
+            infected - before << ' ' << personal << ' ' << networkDevices <<
+            ' ' << blockedLinks << '\n';
+    }
+
+};
+
+#endif
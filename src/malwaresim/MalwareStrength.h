@@ -12,38 +12,40 @@
 /**
  * MalwareStrength is a value type that encapsulates the double-precision value
  * representing how strong a Malware infection is.
+ *
+ * Equality and inequality use a builtin tolerance; the ordering comparisons
+ * compare the values exactly.
  */
-class MalwareStrength {
+class MalwareStrength :
+    public fwk::Ordinal<MalwareStrength, double, fwk::TolerantEquality>
+{
 public:
 
     /** Tolerance for testing for equality or inequality. */
-    static constexpr double tol = 1e-4;
+    static constexpr double tol = fwk::TolerantEquality::tolerance;
 
 
     /**
      * Constructor and conversion from double to abstract value.
      */
-    MalwareStrength(const double value = 0) :
-        value_(value)
-    {
-        if (value > 1 || value < 0) {
-            throw fwk::RangeException("value=range 0..1");
-        }
-    }
-
-    /** Copy constructor. */
-    MalwareStrength(const MalwareStrength& strength) :
-        value_(strength.value_)
+    constexpr MalwareStrength(const double value = 0) :
+        Ordinal(checked(value))
     {
         // Nothing else to do.
     }
 
 
-    /** Numeric value for the strength. */
-    double value() const {
-        return value_;
+    /**
+     * Return a strength for the given value, or an error instead of throwing
+     * if the value is outside 0..1.
+     */
+    static constexpr fwk::Result<MalwareStrength> tryMake(const double value) {
+        return invalid(value) ?
+            fwk::Result<MalwareStrength>::errorNew("value=range 0..1") :
+            fwk::Result<MalwareStrength>(MalwareStrength(value));
     }
 
+
     /** Modify the strength specifying a number. */
     void valueIs(const double value) {
         value_ = value;
@@ -55,40 +57,32 @@ public:
     }
 
 
-    /** Test for equality using a builtin tolerance. */
-    bool operator ==(const MalwareStrength strength) const {
-        return value_ < strength.value_ + tol && value_ > strength.value_ - tol;
-    }
-
-    /** Test for inequality using a builtin tolerance. */
-    bool operator !=(const MalwareStrength strength) const {
-        return value_ >= strength.value_ + tol || value_ <= strength.value_ - tol;
-    }
-
-    bool operator <(const MalwareStrength strength) const {
-        return value_ < strength.value_;
+    constexpr double operator -(const MalwareStrength strength) const {
+        return value_ - strength.value_;
     }
 
-    bool operator <=(const MalwareStrength strength) const {
-        return value_ <= strength.value_;
-    }
+private:
 
-    bool operator >(const MalwareStrength strength) const {
-        return value_ > strength.value_;
+    static constexpr bool invalid(const double value) {
+        return !(value >= 0 && value <= 1);
     }
 
-    bool operator >=(const MalwareStrength strength) const {
-        return value_ >= strength.value_;
+    static constexpr double checked(const double value) {
+        return invalid(value) ?
+            throw fwk::RangeException("value=range 0..1") :
+            value;
     }
 
-    double operator -(const MalwareStrength strength) const {
-        return value_ - strength.value_;
-    }
-
-protected:
+};
 
-   double value_;
+static_assert(
+    sizeof(MalwareStrength) == sizeof(double),
+    "MalwareStrength must be a bare double"
+);
 
-};
+static_assert(
+    std::is_trivially_copyable<MalwareStrength>::value,
+    "MalwareStrength must be trivially copyable"
+);
 
 #endif
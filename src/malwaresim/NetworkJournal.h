@@ -0,0 +1,714 @@
+/**
+ * Journal of the changes to a malware simulation network, for replay.
+ */
+
+#ifndef NETWORKJOURNAL_H
+#define NETWORKJOURNAL_H
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * NetworkJournal records every change to a network as a 16-byte Event:
+ * a device added (deviceNew) or removed (deviceDel), a port rating
+ * changed (ratingIs), a port connected (connectionIs) or disconnected
+ * (disconnectionIs), and a device's health changed (healthIs). Events are
+ * numbered from 0 in the order they happened. networkNew(n) rebuilds
+ * the network as it was after the first n events by applying them
+ * directly, with no script to parse and no infections to flood. A removed
+ * device is unlinked when it is removed, as Network::devicesDel does, so
+ * a port that Network::deviceDel leaves connected to it is free in the
+ * rebuilt network.
+ *
+ * Like NetworkTracker, the journal is a Network::Notifiee with one
+ * Device::Notifiee per device, and a journal attached to a network that
+ * already has devices starts by recording them. Devices are referred
+ * to by number, given in the order they are added; a device added again
+ * gets a new number. A device is recorded when it is added with all of
+ * its state (ratings that differ from its type's default, connections
+ * to devices in the network, health), so devices added in bulk or added
+ * already connected replay exactly. Each reactor keeps the state it last
+ * recorded for its ports and records only differences. A connection
+ * is recorded once, at whichever end reports it first.
+ *
+ * Events go to a ring of eventCapacity events allocated up front. When
+ * the ring is full, it is appended to the spill file if there is one,
+ * and otherwise the oldest events are dropped. Device names are kept
+ * in memory.
+ *
+ * Between changes, the journal takes checkpoints: the recorded network
+ * (devices, ratings that differ from the default, connections, health)
+ * written as the events that rebuild it. networkNew starts from the latest
+ * checkpoint at or before event n whose following events were not dropped,
+ * so replay is bounded by the checkpoint interval rather than by the whole
+ * history, and the network can still be rebuilt after the ring has
+ * wrapped. A checkpoint is taken every half ring, or every twice the size
+ * of the previous checkpoint if that is larger, so recording stays
+ * constant time per event on average; the current network can always be
+ * rebuilt, from a checkpoint taken on demand. Checkpoints older than the
+ * first kept event are dropped. Checkpoints are kept in memory, at most
+ * checkpointLimit of them: when a new one goes over the limit, every other
+ * one is dropped, oldest kept, and from then on they are taken half as
+ * often. Memory therefore stays bounded when spilling, and replay from
+ * the nearest checkpoint grows with the history divided by the limit.
+ */
+class NetworkJournal : public Network::Notifiee {
+public:
+
+    enum Type {
+        deviceNew,
+        deviceDel,
+        ratingIs,
+        connectionIs,
+        disconnectionIs,
+        healthIs
+    };
+
+    enum DeviceType {
+        personal,
+        mobile,
+        firewall
+    };
+
+    /** The far end of a connection. */
+    struct Link {
+        U32 device;
+        U32 port;
+    };
+
+    /**
+     * One change: kind is the DeviceType for deviceNew and the Health
+     * for healthIs; rating is set for ratingIs, and link for connectionIs.
+     */
+    struct Event {
+        U8 type;
+        U8 kind;
+        U16 port;
+        U32 device;
+        union {
+            double rating;
+            Link link;
+        };
+    };
+
+    static_assert(sizeof(Event) == 16, "events are 16 bytes");
+
+    static const U32 none = ~U32(0);
+
+    /** Most checkpoints kept at once. */
+    static constexpr U32 checkpointLimit = 32;
+
+    static_assert(checkpointLimit % 2 == 0, "thinning keeps the newest");
+
+
+    /**
+     * Return a journal of the given network with a ring of eventCapacity
+     * events (rounded up to a power of 2), recording its devices now.
+     */
+    static Ptr<NetworkJournal> instanceNew(
+        const Ptr<Network>& network, const U32 eventCapacity = 1 << 16
+    ) {
+        const Ptr<NetworkJournal> journal = new NetworkJournal(eventCapacity);
+        journal->notifierIs(network);
+
+        for (auto i = network->deviceIter(); i != network->deviceIterEnd(); ++i) {
+            journal->onDeviceNew(i->second);
+        }
+
+        return journal;
+    }
+
+
+    /** Number of events recorded. */
+    U64 eventCount() const {
+        return eventCount_;
+    }
+
+    /** Number of checkpoints kept; a new journal has one, at event 0. */
+    U32 checkpointCount() const {
+        return U32(checkpoints_.size());
+    }
+
+    /** Index of the first event not dropped. */
+    U64 firstEvent() const {
+        return spill_ != null ? fileBegin_ : ringBegin_;
+    }
+
+    /** Event i, which must not have been dropped. */
+    Event event(const U64 i) {
+        Event e;
+        eventsOut(i, 1, &e);
+        return e;
+    }
+
+    /** Name of the device with the given number. */
+    string deviceName(const U32 device) const {
+        return string(
+            names_.data() + nameBegin_[device], names_.data() + nameBegin_[device + 1]
+        );
+    }
+
+
+    /**
+     * Spill full rings to the file at path, which is truncated, so that
+     * no more events are dropped. Returns false if the file cannot be
+     * opened. The file starts with the oldest event in the ring.
+     */
+    bool spillFileIs(const string& path) {
+        if (spill_ != null) {
+            std::fclose(spill_);
+        }
+
+        spill_ = std::fopen(path.c_str(), "w+b");
+        fileBegin_ = ringBegin_;
+        fileEnd_ = ringBegin_;
+        return spill_ != null;
+    }
+
+
+    /**
+     * Return a new network with the given name rebuilt from the first
+     * eventIndex events, starting at the latest usable checkpoint.
+     * Throws RangeException if no checkpoint at or before eventIndex
+     * is followed by events that were all kept.
+     */
+    Ptr<Network> networkNew(const string& name, const U64 eventIndex) {
+        if (eventIndex > eventCount_) {
+            throw fwk::RangeException(name);
+        }
+
+        const Checkpoint* checkpoint = null;
+        for (auto i = checkpoints_.rbegin(); i != checkpoints_.rend(); ++i) {
+            if (i->event <= eventIndex) {
+                checkpoint = &*i;
+                break;
+            }
+        }
+
+        if (checkpoint == null || checkpoint->event < firstEvent()) {
+            if (eventIndex != eventCount_) {
+                throw fwk::RangeException(name);
+            }
+
+            checkpointNew();
+            checkpoint = &checkpoints_.back();
+        }
+
+        const auto network = Network::instanceNew(name);
+        std::vector< Ptr<Device> > devices(nameBegin_.size() - 1);
+        for (const auto& e : checkpoint->events) {
+            eventApply(e, network, devices);
+        }
+
+        static const U64 chunk = 4096;
+        const auto begin = checkpoint->event;
+        std::vector<Event> events(std::min(chunk, eventIndex - begin));
+        for (U64 i = begin; i < eventIndex; i += chunk) {
+            const auto n = std::min(chunk, eventIndex - i);
+            eventsOut(i, n, events.data());
+
+            for (U64 k = 0; k < n; ++k) {
+                eventApply(events[k], network, devices);
+            }
+        }
+
+        return network;
+    }
+
+
+    void onDeviceNew(const Ptr<Device>& device) {
+        checkpointIfDue();
+        if (reactors_.find(device.ptr()) != reactors_.end()) {
+            return;
+        }
+
+        const auto number = U32(reactorByNumber_.size());
+        const auto kind = deviceType(device.ptr());
+        const Ptr<DeviceReactor> reactor = new DeviceReactor(this, device, number, kind);
+        reactors_.emplace(device.ptr(), reactor);
+        reactorByNumber_.push_back(reactor.ptr());
+
+        const auto& name = device->name();
+        names_.insert(names_.end(), name.begin(), name.end());
+        nameBegin_.push_back(U32(names_.size()));
+
+        eventNew(deviceNew, number, 0, kind);
+
+        const auto n = U32(device->portCount());
+        const auto defaultRating = defaultRatings()[kind];
+        for (U32 p = 0; p < n; ++p) {
+            const auto rating = device->portRating(p).value();
+            if (rating != defaultRating) {
+                Event e = eventOf(ratingIs, number, p, 0);
+                e.rating = rating;
+                eventNew(e);
+            }
+            reactor->ports_[p].rating = rating;
+
+            const auto other = reactorFor(device->otherDevice(p).ptr());
+            if (other != null) {
+                linkIs(reactor.ptr(), p, other, device->otherPort(p));
+            }
+        }
+
+        if (device->healthState() == Device::infected) {
+            eventNew(healthIs, number, 0, Device::infected);
+            reactor->health_ = Device::infected;
+        }
+    }
+
+    void onDeviceDel(const Ptr<Device>& device) {
+        checkpointIfDue();
+        const auto i = reactors_.find(device.ptr());
+        if (i == reactors_.end()) {
+            return;
+        }
+
+        eventNew(deviceDel, i->second->number_, 0, 0);
+        reactorByNumber_[i->second->number_] = null;
+        reactors_.erase(i);
+    }
+
+    void onNetworkDestroyed() {
+        checkpointIfDue();
+        for (U32 number = 0; number < reactorByNumber_.size(); ++number) {
+            if (reactorByNumber_[number] != null) {
+                eventNew(deviceDel, number, 0, 0);
+                reactorByNumber_[number] = null;
+            }
+        }
+
+        reactors_.clear();
+    }
+
+
+    NetworkJournal(const NetworkJournal&) = delete;
+
+    void operator =(const NetworkJournal&) = delete;
+
+private:
+
+    /** Last recorded state of a port. */
+    struct PortState {
+        double rating;
+        U32 device2;
+        U32 port2;
+    };
+
+    /** Device::Notifiee recording one device's changes. */
+    class DeviceReactor : public Device::Notifiee {
+    public:
+
+        DeviceReactor(
+            NetworkJournal* const journal, const Ptr<Device>& device, const U32 number,
+            const DeviceType kind
+        ) :
+            journal_(journal),
+            number_(number),
+            kind_(kind),
+            health_(Device::healthy),
+            ports_(device->portCount(), PortState{ 0.0, none, 0 })
+        {
+            notifierIs(device);
+        }
+
+        void onHealth() {
+            journal_->checkpointIfDue();
+            const auto health = notifier()->healthState();
+            if (health != health_) {
+                health_ = health;
+                journal_->eventNew(healthIs, number_, 0, health);
+            }
+        }
+
+        void onPort(const U32 p) {
+            journal_->checkpointIfDue();
+            const auto& device = notifier();
+            auto& port = ports_[p];
+
+            const auto rating = device->portRating(p).value();
+            if (rating != port.rating) {
+                port.rating = rating;
+
+                Event e = eventOf(ratingIs, number_, p, 0);
+                e.rating = rating;
+                journal_->eventNew(e);
+            }
+
+            // A connection to a device outside the network is not recorded.
+            const auto& otherDevice = device->otherDevice(p);
+            if (otherDevice == null) {
+                if (port.device2 != none) {
+                    journal_->eventNew(disconnectionIs, number_, p, 0);
+                    journal_->unlinkIs(this, p);
+                }
+            } else if (const auto other = journal_->reactorFor(otherDevice.ptr())) {
+                const auto p2 = device->otherPort(p);
+                if (port.device2 != other->number_ || port.port2 != p2) {
+                    journal_->linkIs(this, p, other, p2);
+                }
+            }
+        }
+
+
+        NetworkJournal* journal_;
+
+        U32 number_;
+
+        DeviceType kind_;
+
+        Device::Health health_;
+
+        std::vector<PortState> ports_;
+
+    };
+
+
+    typedef std::unordered_map< Device*, Ptr<DeviceReactor> > ReactorMap;
+
+    /** The recorded network after the first event events, as events. */
+    struct Checkpoint {
+        U64 event;
+        std::vector<Event> events;
+    };
+
+
+    /** Events [ringBegin_, eventCount_) are in the ring. */
+    std::vector<Event> ring_;
+    U64 ringBegin_;
+    U64 eventCount_;
+
+    /** Events [fileBegin_, fileEnd_) are in the spill file. */
+    std::FILE* spill_;
+    U64 fileBegin_;
+    U64 fileEnd_;
+
+    /**
+     * Checkpoints in event order; the next is due at checkpointDue_.
+     * The interval between them is multiplied by checkpointSpacing_,
+     * which doubles each time they are thinned out.
+     */
+    std::deque<Checkpoint> checkpoints_;
+    U64 checkpointDue_;
+    U64 checkpointSpacing_;
+
+    ReactorMap reactors_;
+    std::vector<DeviceReactor*> reactorByNumber_;
+
+    /** Device names, one after another; name i ends at nameBegin_[i + 1]. */
+    std::vector<char> names_;
+    std::vector<U32> nameBegin_;
+
+
+    NetworkJournal(const U32 eventCapacity) :
+        ringBegin_(0),
+        eventCount_(0),
+        spill_(null),
+        fileBegin_(0),
+        fileEnd_(0),
+        checkpoints_(1, Checkpoint{ 0, std::vector<Event>() }),
+        checkpointSpacing_(1),
+        nameBegin_(1, 0)
+    {
+        U32 capacity = 1;
+        while (capacity < eventCapacity) {
+            capacity *= 2;
+        }
+        ring_.resize(capacity);
+        checkpointDue_ = std::max<U64>(1, capacity / 2);
+    }
+
+    ~NetworkJournal() {
+        if (spill_ != null) {
+            std::fclose(spill_);
+        }
+    }
+
+
+    static Event eventOf(const Type type, const U32 device, const U32 port, const U32 kind) {
+        Event e;
+        std::memset(&e, 0, sizeof(e));
+        e.type = U8(type);
+        e.kind = U8(kind);
+        e.port = U16(port);
+        e.device = device;
+        return e;
+    }
+
+    void eventNew(const Type type, const U32 device, const U32 port, const U32 kind) {
+        eventNew(eventOf(type, device, port, kind));
+    }
+
+    /** Append an event, spilling or dropping a full ring first. */
+    void eventNew(const Event& e) {
+        if (eventCount_ - ringBegin_ == ring_.size()) {
+            if (spill_ != null) {
+                spill();
+            } else {
+                ++ringBegin_;
+            }
+        }
+
+        ring_[eventCount_ & (ring_.size() - 1)] = e;
+        ++eventCount_;
+    }
+
+    /** Append the ring's events to the spill file, in order, and empty it. */
+    void spill() {
+        const auto mask = ring_.size() - 1;
+        std::fseek(spill_, 0, SEEK_END);
+        while (ringBegin_ < eventCount_) {
+            const auto begin = ringBegin_ & mask;
+            const auto n = std::min<U64>(eventCount_ - ringBegin_, ring_.size() - begin);
+            if (std::fwrite(&ring_[begin], sizeof(Event), n, spill_) != n) {
+                throw fwk::StorageException("journal spill file");
+            }
+            ringBegin_ += n;
+        }
+        fileEnd_ = ringBegin_;
+    }
+
+    /** Copy n events starting at event i, from the spill file or the ring. */
+    void eventsOut(U64 i, U64 n, Event* out) {
+        if (spill_ != null && i >= fileBegin_ && i < fileEnd_) {
+            const auto k = std::min(n, fileEnd_ - i);
+            std::fflush(spill_);
+            std::fseek(spill_, long((i - fileBegin_) * sizeof(Event)), SEEK_SET);
+            if (std::fread(out, sizeof(Event), k, spill_) != k) {
+                throw fwk::StorageException("journal spill file");
+            }
+
+            i += k;
+            n -= k;
+            out += k;
+        }
+
+        if (n > 0 && (i < ringBegin_ || i + n > eventCount_)) {
+            throw fwk::RangeException("journal event " + std::to_string(i));
+        }
+
+        const auto mask = ring_.size() - 1;
+        for (U64 k = 0; k < n; ++k) {
+            out[k] = ring_[(i + k) & mask];
+        }
+    }
+
+
+    /**
+     * Take a checkpoint if one is due. Called at the start of each
+     * notification, when the recorded state matches the events so far.
+     */
+    void checkpointIfDue() {
+        if (eventCount_ >= checkpointDue_) {
+            checkpointNew();
+        }
+    }
+
+    /**
+     * Take a checkpoint of the recorded network after every event so far,
+     * dropping the checkpoints that are no longer followed by kept events,
+     * and every other one if that leaves more than checkpointLimit.
+     * The new checkpoint is kept either way. A connection to a removed
+     * device is left out, since replay unlinks removed devices.
+     */
+    void checkpointNew() {
+        while (!checkpoints_.empty() && checkpoints_.front().event < firstEvent()) {
+            checkpoints_.pop_front();
+        }
+
+        if (checkpoints_.empty() || checkpoints_.back().event != eventCount_) {
+            checkpoints_.push_back(Checkpoint{ eventCount_, std::vector<Event>() });
+            auto& events = checkpoints_.back().events;
+
+            for (const auto reactor : reactorByNumber_) {
+                if (reactor == null) {
+                    continue;
+                }
+
+                const auto number = reactor->number_;
+                events.push_back(eventOf(deviceNew, number, 0, reactor->kind_));
+
+                const auto defaultRating = defaultRatings()[reactor->kind_];
+                for (U32 p = 0; p < reactor->ports_.size(); ++p) {
+                    if (reactor->ports_[p].rating != defaultRating) {
+                        Event e = eventOf(ratingIs, number, p, 0);
+                        e.rating = reactor->ports_[p].rating;
+                        events.push_back(e);
+                    }
+                }
+
+                if (reactor->health_ != Device::healthy) {
+                    events.push_back(eventOf(healthIs, number, 0, reactor->health_));
+                }
+            }
+
+            // Each connection once, from its lower end.
+            for (const auto reactor : reactorByNumber_) {
+                if (reactor == null) {
+                    continue;
+                }
+
+                const auto number = reactor->number_;
+                for (U32 p = 0; p < reactor->ports_.size(); ++p) {
+                    const auto& port = reactor->ports_[p];
+                    if (port.device2 == none || reactorByNumber_[port.device2] == null ||
+                        port.device2 < number || (port.device2 == number && port.port2 < p)
+                    ) {
+                        continue;
+                    }
+
+                    Event e = eventOf(connectionIs, number, p, 0);
+                    e.link.device = port.device2;
+                    e.link.port = port.port2;
+                    events.push_back(e);
+                }
+            }
+        }
+
+        if (checkpoints_.size() > checkpointLimit) {
+            // The count is checkpointLimit + 1, which is odd, so the newest
+            // one is at an even position.
+            std::deque<Checkpoint> kept;
+            for (size_t i = 0; i < checkpoints_.size(); i += 2) {
+                kept.push_back(std::move(checkpoints_[i]));
+            }
+            checkpoints_.swap(kept);
+            checkpointSpacing_ *= 2;
+        }
+
+        checkpointDue_ = eventCount_ + checkpointSpacing_ *
+            std::max<U64>(ring_.size() / 2, 2 * checkpoints_.back().events.size());
+    }
+
+
+    DeviceReactor* reactorFor(Device* const device) const {
+        if (device == null) {
+            return null;
+        }
+
+        const auto i = reactors_.find(device);
+        return i == reactors_.end() ? null : i->second.ptr();
+    }
+
+    /** Forget the connection at the far end of a's port p, if any. */
+    void peerClear(DeviceReactor* const a, const U32 p) {
+        const auto& port = a->ports_[p];
+        if (port.device2 == none) {
+            return;
+        }
+
+        const auto b = reactorByNumber_[port.device2];
+        if (b != null) {
+            auto& far = b->ports_[port.port2];
+            if (far.device2 == a->number_ && far.port2 == p) {
+                far.device2 = none;
+            }
+        }
+    }
+
+    /**
+     * Record a's port p connected to b's port p2 and update both ends,
+     * as connectionIs does: the ports' old connections are cleared.
+     */
+    void linkIs(DeviceReactor* const a, const U32 p, DeviceReactor* const b, const U32 p2) {
+        Event e = eventOf(connectionIs, a->number_, p, 0);
+        e.link.device = b->number_;
+        e.link.port = p2;
+        eventNew(e);
+
+        peerClear(a, p);
+        peerClear(b, p2);
+        a->ports_[p].device2 = b->number_;
+        a->ports_[p].port2 = p2;
+        b->ports_[p2].device2 = a->number_;
+        b->ports_[p2].port2 = p;
+    }
+
+    /** Update both ends for a recorded disconnection of a's port p. */
+    void unlinkIs(DeviceReactor* const a, const U32 p) {
+        peerClear(a, p);
+        a->ports_[p].device2 = none;
+    }
+
+
+    static DeviceType deviceType(Device* const device) {
+        if (dynamic_cast<MobileDevice*>(device) != null) {
+            return mobile;
+        }
+
+        if (dynamic_cast<FirewallDevice*>(device) != null) {
+            return firewall;
+        }
+
+        return personal;
+    }
+
+    static Ptr<Device> deviceOf(const U8 kind, const string& name) {
+        switch (kind) {
+        case mobile:
+            return MobileDevice::instanceNew(name);
+
+        case firewall:
+            return FirewallDevice::instanceNew(name);
+
+        default:
+            return PersonalDevice::instanceNew(name);
+        }
+    }
+
+    /** Port rating of a new device of each DeviceType. */
+    static const double* defaultRatings() {
+        static const double ratings[] = {
+            PersonalDevice::instanceNew("personal")->portRating(0).value(),
+            MobileDevice::instanceNew("mobile")->portRating(0).value(),
+            FirewallDevice::instanceNew("firewall")->portRating(0).value()
+        };
+        return ratings;
+    }
+
+    void eventApply(
+        const Event& e, const Ptr<Network>& network, std::vector< Ptr<Device> >& devices
+    ) {
+        switch (e.type) {
+        case deviceNew:
+            devices[e.device] = deviceOf(e.kind, deviceName(e.device));
+            network->deviceIs(devices[e.device]);
+            break;
+
+        case deviceDel: {
+            // Unlink the device first, as Network::devicesDel does, so that
+            // it and its peers do not keep each other alive.
+            const auto& device = devices[e.device];
+            for (U32 p = 0; p < device->portCount(); ++p) {
+                device->availablePortIsTrue(p);
+            }
+
+            network->deviceDel(device->name());
+            devices[e.device] = null;
+            break;
+        }
+
+        case ratingIs:
+            devices[e.device]->portRatingIs(e.port, e.rating);
+            break;
+
+        case connectionIs:
+            devices[e.device]->connectionIs(e.port, devices[e.link.device], e.link.port);
+            break;
+
+        case disconnectionIs:
+            devices[e.device]->availablePortIsTrue(e.port);
+            break;
+
+        case healthIs:
+            devices[e.device]->healthIs(Device::Health(e.kind));
+            break;
+        }
+    }
+
+};
+
+#endif
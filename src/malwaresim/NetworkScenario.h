@@ -0,0 +1,126 @@
+/**
+ * Copy-on-write what-if branches of a network.
+ */
+
+#ifndef NETWORKSCENARIO_H
+#define NETWORKSCENARIO_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/**
+ * NetworkScenario is a branch of a network's port connections, ratings
+ * and infections that can be modified and infected without touching
+ * the network or any other branch, e.g. to ask "what if we harden
+ * this firewall".
+ *
+ * A scenario holds a PagedPortTable. Creating one from a network copies
+ * the network's table once, in time and memory linear in its rows,
+ * so that the network's own table can stay flat. Branching a scenario
+ * with scenarioNew is O(1): pages of the table are shared with
+ * the parent until one side modifies them, then only the modified
+ * pages are copied, so memory grows with the size of the change.
+ *
+ * Devices are identified by the ids they had in the network (Device::id())
+ * when the first snapshot was taken. A scenario never dereferences
+ * the network's Device objects, so it stays valid after they are deleted.
+ */
+class NetworkScenario : public fwk::PtrInterface {
+public:
+
+    /** Return a scenario branched from the network as it is now. */
+    static Ptr<NetworkScenario> instanceNew(const Ptr<Network>& network) {
+        return new NetworkScenario(
+            PagedPortTable(network->portTable()),
+            network->infectionThreadCount()
+        );
+    }
+
+    /** Return a scenario branched from this one as it is now. */
+    Ptr<NetworkScenario> scenarioNew() const {
+        return new NetworkScenario(portTable_, infectionThreadCount_);
+    }
+
+
+    /** Port connections, ratings and infections of this scenario. */
+    const PagedPortTable& portTable() const {
+        return portTable_;
+    }
+
+
+    /** Anti-malware rating of port p of the device with the given id. */
+    MalwareStrength portRating(const U32 id, const U32 p) const {
+        return portTable_.rating(portTable_.row(id, p));
+    }
+
+    /** Modify the rating of port p of the device with the given id. */
+    void portRatingIs(const U32 id, const U32 p, const MalwareStrength rating) {
+        portTable_.ratingIs(id, p, rating.value());
+    }
+
+
+    /** Flag indicating whether the device with the given id is infected. */
+    bool infected(const U32 id) const {
+        return portTable_.infected(id);
+    }
+
+    /** Number of infected devices. */
+    U32 infectedCount() const {
+        return portTable_.infectedCount();
+    }
+
+
+    /**
+     * Infect this scenario as Network::infectionIs would infect the network,
+     * entering the device with the given id on port p. Returns the ids
+     * of the newly infected devices in the order they were infected.
+     */
+    _noinline
+    std::vector<U32> infectionIs(
+        const MalwareStrength strength, const U32 id, const U32 p
+    ) {
+        if (id >= portTable_.deviceCount() || p >= portTable_.portCount(id) ||
+            portTable_.device(id) == null || portTable_.infected(id) ||
+            portRating(id, p).value() > strength.value() - MalwareStrength::tol
+        ) {
+            return std::vector<U32>();
+        }
+
+        const auto order = infectionEngine_.spreadNew(portTable_, strength, id);
+        for (const auto d : order) {
+            portTable_.infectedIs(d, true);
+        }
+
+        return order;
+    }
+
+
+    NetworkScenario(const NetworkScenario&) = delete;
+
+    void operator =(const NetworkScenario&) = delete;
+
+private:
+
+    PagedPortTable portTable_;
+
+    U32 infectionThreadCount_;
+
+    InfectionEngine infectionEngine_;
+
+
+    NetworkScenario(const PagedPortTable& table, const U32 infectionThreadCount) :
+        portTable_(table),
+        infectionThreadCount_(infectionThreadCount),
+        infectionEngine_(infectionThreadCount)
+    {
+        // Nothing else to do.
+    }
+
+    ~NetworkScenario() {
+        // Nothing to do.
+    }
+
+};
+
+#endif
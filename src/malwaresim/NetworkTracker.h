@@ -0,0 +1,250 @@
+/**
+ * Incremental statistics for a malware simulation network.
+ */
+
+#ifndef NETWORKTRACKER_H
+#define NETWORKTRACKER_H
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * NetworkTracker keeps device, infected, free-port and connection counts
+ * for a network, with a breakdown by device type, up to date as
+ * notifications arrive, so that no statistic requires walking the devices.
+ *
+ * The tracker is a Network::Notifiee and attaches one Device::Notifiee
+ * to each device in the network. Each reactor remembers the health
+ * and port states it last counted for its device, so every notification
+ * is applied as a difference in O(1), and a device removed in bulk
+ * (whose ports are cleared without onPort notifications) is subtracted
+ * exactly as it was counted.
+ *
+ * The counters are atomics updated with relaxed stores on the notifying
+ * thread, so other threads may poll them at any time.
+ */
+class NetworkTracker : public Network::Notifiee {
+public:
+
+    /** Return a tracker for the given network, counting its devices now. */
+    static Ptr<NetworkTracker> instanceNew(const Ptr<Network>& network) {
+        const Ptr<NetworkTracker> tracker = new NetworkTracker();
+        tracker->notifierIs(network);
+
+        for (auto i = network->deviceIter(); i != network->deviceIterEnd(); ++i) {
+            tracker->onDeviceNew(i->second);
+        }
+
+        return tracker;
+    }
+
+
+    /** Number of devices in the network. */
+    U32 deviceCount() const {
+        return deviceCount_.load(std::memory_order_relaxed);
+    }
+
+    /** Number of personal devices that are not mobile devices. */
+    U32 personalCount() const {
+        return personalCount_.load(std::memory_order_relaxed);
+    }
+
+    /** Number of mobile devices. */
+    U32 mobileCount() const {
+        return mobileCount_.load(std::memory_order_relaxed);
+    }
+
+    /** Number of firewall devices. */
+    U32 firewallCount() const {
+        return firewallCount_.load(std::memory_order_relaxed);
+    }
+
+    /** Number of infected devices. */
+    U32 infectedCount() const {
+        return infectedCount_.load(std::memory_order_relaxed);
+    }
+
+    /** Number of ports on the network's devices not connected to a device. */
+    U32 freePortCount() const {
+        return freePortCount_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Number of connected ports on the network's devices. A connection
+     * between two devices in the network is counted at both ends.
+     */
+    U32 connectionCount() const {
+        return connectionCount_.load(std::memory_order_relaxed);
+    }
+
+
+    void onDeviceNew(const Ptr<Device>& device) {
+        if (reactors_.find(device.ptr()) != reactors_.end()) {
+            return;
+        }
+
+        const Ptr<DeviceReactor> reactor = new DeviceReactor(this, device);
+        reactors_.emplace(device.ptr(), reactor);
+
+        add(deviceCount_, 1);
+        add(typeCount(device.ptr()), 1);
+        reactor->counted(1);
+    }
+
+    void onDeviceDel(const Ptr<Device>& device) {
+        const auto i = reactors_.find(device.ptr());
+        if (i == reactors_.end()) {
+            return;
+        }
+
+        add(deviceCount_, -1);
+        add(typeCount(device.ptr()), -1);
+        i->second->counted(-1);
+
+        reactors_.erase(i);
+    }
+
+    void onNetworkDestroyed() {
+        reactors_.clear();
+
+        for (auto c : { &deviceCount_, &personalCount_, &mobileCount_,
+            &firewallCount_, &infectedCount_, &freePortCount_,
+            &connectionCount_, &otherCount_
+        }) {
+            c->store(0, std::memory_order_relaxed);
+        }
+    }
+
+
+    NetworkTracker(const NetworkTracker&) = delete;
+
+    void operator =(const NetworkTracker&) = delete;
+
+private:
+
+    /** Device::Notifiee applying one device's changes to the counts. */
+    class DeviceReactor : public Device::Notifiee {
+    public:
+
+        DeviceReactor(NetworkTracker* const tracker, const Ptr<Device>& device) :
+            tracker_(tracker),
+            infected_(device->healthState() == Device::infected),
+            connected_(device->portCount())
+        {
+            const auto n = U32(device->portCount());
+            for (U32 p = 0; p < n; ++p) {
+                connected_[p] = !device->availablePort(p);
+            }
+
+            notifierIs(device);
+        }
+
+        /** Add (sign 1) or remove (sign -1) the last counted states. */
+        void counted(const int sign) {
+            tracker_->add(tracker_->infectedCount_, infected_ ? sign : 0);
+
+            int connected = 0;
+            for (const auto c : connected_) {
+                connected += c;
+            }
+
+            tracker_->add(tracker_->connectionCount_, sign * connected);
+            tracker_->add(
+                tracker_->freePortCount_,
+                sign * (int(connected_.size()) - connected)
+            );
+        }
+
+        void onHealth() {
+            const bool infected = notifier()->healthState() == Device::infected;
+            if (infected != infected_) {
+                infected_ = infected;
+                tracker_->add(tracker_->infectedCount_, infected ? 1 : -1);
+            }
+        }
+
+        void onPort(const U32 p) {
+            const U8 connected = !notifier()->availablePort(p);
+            if (connected != connected_[p]) {
+                connected_[p] = connected;
+
+                const int delta = connected ? 1 : -1;
+                tracker_->add(tracker_->connectionCount_, delta);
+                tracker_->add(tracker_->freePortCount_, -delta);
+            }
+        }
+
+    private:
+
+        NetworkTracker* tracker_;
+
+        bool infected_;
+
+        std::vector<U8> connected_;
+
+    };
+
+
+    typedef std::unordered_map< Device*, Ptr<DeviceReactor> > ReactorMap;
+
+
+    std::atomic<U32> deviceCount_;
+    std::atomic<U32> personalCount_;
+    std::atomic<U32> mobileCount_;
+    std::atomic<U32> firewallCount_;
+    std::atomic<U32> infectedCount_;
+    std::atomic<U32> freePortCount_;
+    std::atomic<U32> connectionCount_;
+
+    /** Counter for devices of other types. */
+    std::atomic<U32> otherCount_;
+
+    ReactorMap reactors_;
+
+
+    NetworkTracker() :
+        deviceCount_(0),
+        personalCount_(0),
+        mobileCount_(0),
+        firewallCount_(0),
+        infectedCount_(0),
+        freePortCount_(0),
+        connectionCount_(0),
+        otherCount_(0)
+    {
+        // Nothing else to do.
+    }
+
+    ~NetworkTracker() {
+        // Nothing to do.
+    }
+
+
+    /** Adjust a counter; only the notifying thread writes counters. */
+    static void add(std::atomic<U32>& counter, const int delta) {
+        counter.store(
+            counter.load(std::memory_order_relaxed) + U32(delta),
+            std::memory_order_relaxed
+        );
+    }
+
+    std::atomic<U32>& typeCount(Device* const device) {
+        if (dynamic_cast<MobileDevice*>(device) != null) {
+            return mobileCount_;
+        }
+
+        if (dynamic_cast<PersonalDevice*>(device) != null) {
+            return personalCount_;
+        }
+
+        if (dynamic_cast<FirewallDevice*>(device) != null) {
+            return firewallCount_;
+        }
+
+        return otherCount_;
+    }
+
+};
+
+#endif
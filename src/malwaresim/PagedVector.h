@@ -0,0 +1,169 @@
+/**
+ * Growable array stored in shared, copy-on-write pages.
+ */
+
+#ifndef PAGEDVECTOR_H
+#define PAGEDVECTOR_H
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+/**
+ * PagedVector is a value type holding a growable array in fixed-size pages.
+ *
+ * Copying a PagedVector is O(1): the copy shares the original's page
+ * directory. The first modification through either copy gives it its own
+ * directory (one pointer per page), and modifying an element then copies
+ * only the page holding it. Memory therefore grows with the number
+ * of pages modified, not with the size of the array.
+ *
+ * Elements are read with operator[] and modified with valueIs; there is
+ * no mutable element reference, so a read never triggers a copy.
+ */
+template <class T, U32 pageBits = 12>
+class PagedVector {
+public:
+
+    static constexpr size_t pageSize = size_t(1) << pageBits;
+
+
+    PagedVector() :
+        directory_(std::make_shared<Directory>()),
+        size_(0)
+    {
+        // Nothing else to do.
+    }
+
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    const T& operator [](const size_t i) const {
+        return (*(*directory_)[i >> pageBits])[i & pageMask];
+    }
+
+
+    /** Modify the element at the given index, copying its page if shared. */
+    void valueIs(const size_t i, const T& value) {
+        page(i >> pageBits)[i & pageMask] = value;
+    }
+
+    /**
+     * Copy the n elements starting at from to the n starting at to.
+     * The two ranges must not overlap.
+     */
+    void copyIs(const size_t to, const size_t from, const size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            valueIs(to + i, (*this)[from + i]);
+        }
+    }
+
+    /** Replace the elements with the n given ones, in pages of its own. */
+    void valuesIs(const T* const values, const size_t n) {
+        auto directory = std::make_shared<Directory>();
+        directory->reserve((n + pageSize - 1) >> pageBits);
+        for (size_t i = 0; i < n; i += pageSize) {
+            const auto page = std::make_shared<Page>();
+            std::copy_n(values + i, std::min(pageSize, n - i), page->data());
+            directory->push_back(page);
+        }
+
+        directory_ = directory;
+        size_ = n;
+    }
+
+    void push_back(const T& value) {
+        if ((size_ & pageMask) == 0) {
+            directory().push_back(std::make_shared<Page>());
+        }
+
+        page(size_ >> pageBits)[size_ & pageMask] = value;
+        ++size_;
+    }
+
+    /** Grow to the given size, filling new elements with the given value. */
+    void resize(const size_t size, const T& value) {
+        while (size_ < size) {
+            push_back(value);
+        }
+    }
+
+    void reserve(const size_t size) {
+        directory().reserve((size + pageSize - 1) >> pageBits);
+    }
+
+    void swap(PagedVector& v) {
+        directory_.swap(v.directory_);
+        std::swap(size_, v.size_);
+    }
+
+
+    /** Number of pages. */
+    size_t pageCount() const {
+        return directory_->size();
+    }
+
+    /** Elements of the given page, for kernels that scan a page at a time. */
+    const T* pageData(const size_t p) const {
+        return (*directory_)[p]->data();
+    }
+
+    /** Number of pages not shared with any other PagedVector. */
+    size_t ownPageCount() const {
+        if (directory_.use_count() > 1) {
+            return 0;
+        }
+
+        size_t count = 0;
+        for (const auto& p : *directory_) {
+            if (p.use_count() == 1) {
+                ++count;
+            }
+        }
+
+        return count;
+    }
+
+private:
+
+    static const size_t pageMask = pageSize - 1;
+
+
+    typedef std::array<T, pageSize> Page;
+
+    typedef std::vector< std::shared_ptr<Page> > Directory;
+
+
+    std::shared_ptr<Directory> directory_;
+    size_t size_;
+
+
+    /** Directory for modification, copied first if shared. */
+    Directory& directory() {
+        if (directory_.use_count() > 1) {
+            directory_ = std::make_shared<Directory>(*directory_);
+        }
+
+        return *directory_;
+    }
+
+    /** Page for modification, copied first if shared. */
+    Page& page(const size_t p) {
+        auto& page = directory()[p];
+        if (page.use_count() > 1) {
+            page = std::make_shared<Page>(*page);
+        }
+
+        return *page;
+    }
+
+};
+
+#endif
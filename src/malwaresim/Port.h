@@ -9,10 +9,105 @@
 #ifndef PORT_H
 #define PORT_H
 
+#include <vector>
+
 using fwk::Ptr;
+using fwk::Time;
 
 class Device;
 
+/**
+ * PortLink is the connection half of a port: the device to which the port
+ * is connected and that device's port, or null and 0. A device keeps one
+ * PortLink per port, and the ratings separately in PortRatings.
+ */
+class PortLink {
+public:
+
+    PortLink() :
+        otherDevice_(null),
+        otherPort_(0)
+    {
+        // Nothing else to do.
+    }
+
+
+    /** Device connected to this port or null if not connected. */
+    const Ptr<Device>& otherDevice() const {
+        return otherDevice_;
+    }
+
+    /** Connected device's port number or 0 if not connected. */
+    U32 otherPort() const {
+        return otherPort_;
+    }
+
+    /** Modify the connection for this port. */
+    void connectionIs(const Ptr<Device>& device, const U32 port) {
+        otherDevice_ = device.ptr();
+        otherPort_ = port;
+    }
+
+private:
+
+    Ptr<Device> otherDevice_;
+
+    U32 otherPort_;
+
+};
+
+/**
+ * PortRatings is a table of the anti-malware ratings of a device's ports.
+ * A table can be shared: a device and its clones use one table until one
+ * of them changes a rating, which gives that device a private copy first.
+ * A table with more than one reference must not be modified.
+ */
+class PortRatings : public fwk::PtrInterface {
+public:
+
+    /** Return a new table of n ports with the given rating. */
+    static Ptr<PortRatings> instanceNew(const U32 n, const MalwareStrength rating) {
+        return new PortRatings(n, rating);
+    }
+
+    /** Return a new, unshared copy of the given table. */
+    static Ptr<PortRatings> instanceNew(const PortRatings& ratings) {
+        return new PortRatings(ratings);
+    }
+
+
+    U32 portCount() const {
+        return U32(ratings_.size());
+    }
+
+    MalwareStrength rating(const U32 p) const {
+        return ratings_[p];
+    }
+
+    /** Modify a rating. Only for a table with one reference. */
+    void ratingIs(const U32 p, const MalwareStrength rating) {
+        ratings_[p] = rating;
+    }
+
+private:
+
+    std::vector<MalwareStrength> ratings_;
+
+
+    PortRatings(const U32 n, const MalwareStrength rating) :
+        ratings_(n, rating)
+    {
+        // Nothing else to do.
+    }
+
+    PortRatings(const PortRatings& ratings) :
+        ratings_(ratings.ratings_)
+    {
+        // Nothing else to do.
+    }
+
+};
+
 /**
  * Port is a value type containing an anti-malware rating and
  * connection information for a port on a device. The port's otherDevice
@@ -44,6 +139,15 @@ public:
         // Nothing else to do.
     }
 
+    /** A port with the given rating and connection. */
+    Port(const MalwareStrength rating, const PortLink& link) :
+        rating_(rating),
+        otherDevice_(link.otherDevice()),
+        otherPort_(link.otherPort())
+    {
+        // Nothing else to do.
+    }
+
     /** Copy constructor. */
     Port(const Port& port) :
         rating_(port.rating_),
@@ -76,6 +180,52 @@ public:
     }
 
 
+    /**
+     * Flag indicating whether this port stops malware of the given strength.
+     * Malware gets through only if its strength exceeds the port's rating
+     * by more than the MalwareStrength tolerance.
+     */
+    bool blocks(const MalwareStrength strength) const {
+        return rating_ >= strength || rating_ == strength;
+    }
+
+    /**
+     * Probability that malware of the given strength crosses this port
+     * when it spreads over time: 0 if the port blocks it, otherwise
+     * the amount by which the strength exceeds the rating as a fraction
+     * of the most it could exceed it, so full-strength malware always
+     * gets through an open port.
+     */
+    double transmissionProbability(const MalwareStrength strength) const {
+        return transmissionProbability(rating_.value(), strength.value());
+    }
+
+    /**
+     * Time for malware to cross this port, given the time to cross
+     * an unprotected port. The time grows with the rating, to twice
+     * hopTime for a rating of 1.
+     */
+    Time transmissionDelay(const Time hopTime) const {
+        return transmissionDelay(rating_.value(), hopTime);
+    }
+
+    /** transmissionProbability for a port with the given rating. */
+    static double transmissionProbability(
+        const double rating, const double strength
+    ) {
+        if (rating > strength - MalwareStrength::tol) {
+            return 0;
+        }
+
+        return (strength - rating) / (1 - rating);
+    }
+
+    /** transmissionDelay for a port with the given rating. */
+    static Time transmissionDelay(const double rating, const Time hopTime) {
+        return Time::fromTicks(S64(double(hopTime.ticks()) * (1 + rating)));
+    }
+
+
     /**
      * Device connected to this port or null if not connected.
      */
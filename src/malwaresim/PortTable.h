@@ -0,0 +1,455 @@
+/**
+ * Dense port-connection table for a network.
+ */
+
+#ifndef PORTTABLE_H
+#define PORTTABLE_H
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+class Device;
+
+/**
+ * PortTable mirrors the ports of every device in a network as rows
+ * of parallel arrays, so traversals read plain integers and doubles
+ * instead of chasing Ptr<Device> links through each Device's ports.
+ *
+ * Each device in the network has a dense id. Its rows are contiguous,
+ * starting at portBegin(id), one row per port in port order (compressed
+ * sparse rows). A row holds the owning device id, the port number,
+ * the peer device id and port (peer is none when the port is not connected
+ * to a device in the same network), and the port's rating.
+ *
+ * The table also keeps a bitmap of infected devices indexed by id,
+ * so finding infected devices scans one bit per device, and a count
+ * of the bits set.
+ *
+ * The columns are stored as Columns::Vector. A network's own table,
+ * PortTable, keeps each column flat (FlatVector), so reading a row is
+ * one load and writing one has nothing to check. A snapshot taken for
+ * NetworkScenario is a PagedPortTable, whose columns are copy-on-write
+ * PagedVectors: it is built from a PortTable by copying the columns
+ * once, and copying it after that is O(1), sharing every page with
+ * the original until either one modifies it.
+ *
+ * Ratings are kept as doubles rather than floats so that comparisons
+ * against a MalwareStrength give exactly the same answer as Port::blocks.
+ * Each row also keeps the rating of its peer's port, the port malware
+ * leaving through the row must get into (infinity if the row is not
+ * connected), so openRowsIs can test a run of rows with RatingKernel
+ * without following links.
+ *
+ * Device keeps its rows current; the table itself does not post
+ * notifications or check consistency. Rows of a deleted device stay
+ * in place, disconnected, until the table is compacted; compaction
+ * renumbers the remaining devices.
+ */
+template <class Columns>
+class BasicPortTable {
+public:
+
+    /** Id or peer of a row that does not refer to a device. */
+    static constexpr U32 none = ~U32(0);
+
+
+    BasicPortTable() :
+        infectedCount_(0)
+    {
+        portBegin_.push_back(0);
+    }
+
+    /** Copy the given table into this one's column type. */
+    template <class Other>
+    explicit BasicPortTable(const BasicPortTable<Other>& table) :
+        infectedCount_(table.infectedCount_)
+    {
+        devices_.valuesIs(table.devices_.data(), table.devices_.size());
+        infected_.valuesIs(table.infected_.data(), table.infected_.size());
+        portBegin_.valuesIs(table.portBegin_.data(), table.portBegin_.size());
+        deviceId_.valuesIs(table.deviceId_.data(), table.deviceId_.size());
+        port_.valuesIs(table.port_.data(), table.port_.size());
+        peer_.valuesIs(table.peer_.data(), table.peer_.size());
+        peerPort_.valuesIs(table.peerPort_.data(), table.peerPort_.size());
+        rating_.valuesIs(table.rating_.data(), table.rating_.size());
+        peerRating_.valuesIs(
+            table.peerRating_.data(), table.peerRating_.size()
+        );
+    }
+
+
+    /** Number of ids allocated, including those of deleted devices. */
+    U32 deviceCount() const {
+        return U32(devices_.size());
+    }
+
+    /** Device with the given id, or null if it was deleted. */
+    Device* device(const U32 id) const {
+        return devices_[id];
+    }
+
+    /** First row of the given device. */
+    U32 portBegin(const U32 id) const {
+        return portBegin_[id];
+    }
+
+    /** Number of rows of the given device. */
+    U32 portCount(const U32 id) const {
+        return portBegin_[id + 1] - portBegin_[id];
+    }
+
+    /** Row for port p of the given device. */
+    U32 row(const U32 id, const U32 p) const {
+        return portBegin_[id] + p;
+    }
+
+
+    /** Number of rows. */
+    U32 rowCount() const {
+        return U32(deviceId_.size());
+    }
+
+    U32 deviceId(const U32 row) const {
+        return deviceId_[row];
+    }
+
+    U32 port(const U32 row) const {
+        return port_[row];
+    }
+
+    U32 peer(const U32 row) const {
+        return peer_[row];
+    }
+
+    U32 peerPort(const U32 row) const {
+        return peerPort_[row];
+    }
+
+    double rating(const U32 row) const {
+        return rating_[row];
+    }
+
+    /** Rating of the peer's port, or infinity if the row is not connected. */
+    double peerRating(const U32 row) const {
+        return peerRating_[row];
+    }
+
+    /**
+     * Set one bit in the mask for each row from begin, a multiple of 64,
+     * to end: 1 if malware with the given open threshold (RatingKernel)
+     * gets from the row's device to its peer, 0 if the peer's port blocks
+     * it or the row is not connected.
+     */
+    void openRowsIs(
+        const U32 begin, const U32 end, const double threshold, U64* const mask
+    ) const {
+        const auto pageSize = RatingVector::pageSize;
+        for (size_t r = begin; r < end;) {
+            const auto n = std::min(size_t(end), (r / pageSize + 1) * pageSize) - r;
+            RatingKernel::openMaskIs(
+                peerRating_.pageData(r / pageSize) + r % pageSize, U32(n),
+                threshold, mask + (r - begin) / 64
+            );
+            r += n;
+        }
+    }
+
+
+    /** Flag indicating whether the device with the given id is infected. */
+    bool infected(const U32 id) const {
+        return (infected_[id / wordBits] >> (id % wordBits)) & 1;
+    }
+
+    /** Modify the infected flag of the device with the given id. */
+    void infectedIs(const U32 id, const bool infected) {
+        const auto bit = U64(1) << (id % wordBits);
+        const auto word = infected_[id / wordBits];
+        if (infected != ((word & bit) != 0)) {
+            infected_.valueIs(id / wordBits, word ^ bit);
+            if (infected) {
+                ++infectedCount_;
+            } else {
+                --infectedCount_;
+            }
+        }
+    }
+
+    /** Number of infected devices. */
+    U32 infectedCount() const {
+        return infectedCount_;
+    }
+
+    /**
+     * Call f with the id of each infected device in increasing order.
+     * Words with no infected devices are skipped whole.
+     */
+    template <class Func>
+    void infectedEach(const Func& f) const {
+        const auto pages = infected_.pageCount();
+        for (size_t p = 0; p < pages; ++p) {
+            const auto words = infected_.pageData(p);
+            const auto n = pageWordCount(p);
+            const auto base = p * InfectedVector::pageSize;
+            for (size_t w = 0; w < n; ++w) {
+                for (auto word = words[w]; word != 0; word &= word - 1) {
+                    f(U32((base + w) * wordBits + lowestBit(word)));
+                }
+            }
+        }
+    }
+
+    /**
+     * Number of column pages this table does not share with a snapshot,
+     * a measure of the memory a snapshot has cost. PagedPortTable only.
+     */
+    size_t ownPageCount() const {
+        return devices_.ownPageCount() + infected_.ownPageCount() +
+            portBegin_.ownPageCount() + deviceId_.ownPageCount() +
+            port_.ownPageCount() + peer_.ownPageCount() +
+            peerPort_.ownPageCount() + rating_.ownPageCount() +
+            peerRating_.ownPageCount();
+    }
+
+
+    /**
+     * Allocate an id and disconnected rows with zero ratings for a device
+     * with the given number of ports.
+     */
+    U32 deviceNew(Device* const device, const U32 portCount) {
+        const auto id = deviceCount();
+        devices_.push_back(device);
+        infected_.resize(id / wordBits + 1, 0);
+
+        const auto begin = rowCount();
+        const auto end = begin + portCount;
+        portBegin_.push_back(end);
+
+        deviceId_.resize(end, id);
+        peer_.resize(end, none);
+        peerPort_.resize(end, 0);
+        rating_.resize(end, 0.0);
+        peerRating_.resize(end, unconnected);
+
+        for (U32 p = 0; p < portCount; ++p) {
+            port_.push_back(p);
+        }
+
+        return id;
+    }
+
+    /**
+     * Allocate an id for a clone of the given device. The clone's rows
+     * copy the source's ratings as one block and are disconnected.
+     */
+    U32 deviceCloneNew(Device* const device, const U32 source) {
+        const auto begin = portBegin_[source];
+        const auto count = portCount(source);
+
+        const auto id = deviceNew(device, count);
+        rating_.copyIs(portBegin_[id], begin, count);
+
+        return id;
+    }
+
+    /** Reserve space for the given numbers of additional devices and rows. */
+    void reserve(const U32 devices, const U32 rows) {
+        devices_.reserve(devices_.size() + devices);
+        infected_.reserve((devices_.size() + devices) / wordBits + 1);
+        portBegin_.reserve(portBegin_.size() + devices);
+
+        const auto n = rowCount() + rows;
+        deviceId_.reserve(n);
+        port_.reserve(n);
+        peer_.reserve(n);
+        peerPort_.reserve(n);
+        rating_.reserve(n);
+        peerRating_.reserve(n);
+    }
+
+    /**
+     * Forget the device with the given id. Its rows are disconnected;
+     * rows of other devices that refer to it must be updated by the caller.
+     */
+    void deviceDel(const U32 id) {
+        devices_.valueIs(id, null);
+        infectedIs(id, false);
+
+        const auto end = portBegin_[id + 1];
+        for (auto r = portBegin_[id]; r < end; ++r) {
+            peer_.valueIs(r, none);
+            peerPort_.valueIs(r, 0);
+            peerRating_.valueIs(r, unconnected);
+        }
+    }
+
+
+    /**
+     * Remove the rows of deleted devices and of the devices flagged
+     * in doomed, indexed by id, renumbering the remaining devices densely
+     * in their current order. Rows that referred to a removed device
+     * become disconnected. Returns the new id of each old id, or none.
+     */
+    _noinline
+    std::vector<U32> compactIs(const std::vector<U8>& doomed) {
+        const auto n = deviceCount();
+
+        std::vector<U32> newId(n, none);
+        U32 keptDevices = 0;
+        U32 keptRows = 0;
+        for (U32 id = 0; id < n; ++id) {
+            if (devices_[id] != null && !doomed[id]) {
+                newId[id] = keptDevices++;
+                keptRows += portCount(id);
+            }
+        }
+
+        BasicPortTable table;
+        table.reserve(keptDevices, keptRows);
+
+        for (U32 id = 0; id < n; ++id) {
+            if (newId[id] == none) {
+                continue;
+            }
+
+            const auto to = table.deviceNew(devices_[id], portCount(id));
+            table.infectedIs(to, infected(id));
+
+            const auto begin = portBegin_[id];
+            const auto count = portCount(id);
+            const auto first = table.portBegin(to);
+            for (U32 p = 0; p < count; ++p) {
+                const auto peer = peer_[begin + p];
+                if (peer != none && newId[peer] != none) {
+                    table.peer_.valueIs(first + p, newId[peer]);
+                    table.peerPort_.valueIs(first + p, peerPort_[begin + p]);
+                    table.peerRating_.valueIs(first + p, peerRating_[begin + p]);
+                }
+
+                table.rating_.valueIs(first + p, rating_[begin + p]);
+            }
+        }
+
+        swap(table);
+
+        return newId;
+    }
+
+
+    void ratingIs(const U32 id, const U32 p, const double rating) {
+        const auto r = row(id, p);
+        rating_.valueIs(r, rating);
+        peerRatingIs(r);
+    }
+
+    void connectionIs(
+        const U32 id, const U32 p, const U32 peer, const U32 peerPort
+    ) {
+        const auto r = row(id, p);
+        peer_.valueIs(r, peer);
+        peerPort_.valueIs(r, peerPort);
+        peerRating_.valueIs(
+            r, peer == none ? unconnected : rating_[row(peer, peerPort)]
+        );
+        peerRatingIs(r);
+    }
+
+private:
+
+    static const U32 wordBits = 64;
+
+    static constexpr double unconnected = std::numeric_limits<double>::infinity();
+
+
+    typedef typename Columns::template Vector<U64> InfectedVector;
+    typedef typename Columns::template Vector<double> RatingVector;
+    typedef typename Columns::template Vector<U32> IndexVector;
+
+
+    template <class Other>
+    friend class BasicPortTable;
+
+
+    typename Columns::template Vector<Device*> devices_;
+    InfectedVector infected_;
+    U32 infectedCount_;
+    IndexVector portBegin_;
+
+    IndexVector deviceId_;
+    IndexVector port_;
+    IndexVector peer_;
+    IndexVector peerPort_;
+    RatingVector rating_;
+    RatingVector peerRating_;
+
+
+    void swap(BasicPortTable& table) {
+        devices_.swap(table.devices_);
+        infected_.swap(table.infected_);
+        std::swap(infectedCount_, table.infectedCount_);
+        portBegin_.swap(table.portBegin_);
+        deviceId_.swap(table.deviceId_);
+        port_.swap(table.port_);
+        peer_.swap(table.peer_);
+        peerPort_.swap(table.peerPort_);
+        rating_.swap(table.rating_);
+        peerRating_.swap(table.peerRating_);
+    }
+
+    /**
+     * Copy the rating of row r into its peer's row if the peer is
+     * connected back to it. The two rows of a link are set one at a time,
+     * so whichever is set second brings both up to date.
+     */
+    void peerRatingIs(const U32 r) {
+        const auto peer = peer_[r];
+        if (peer == none) {
+            return;
+        }
+
+        const auto pr = row(peer, peerPort_[r]);
+        if (peer_[pr] == deviceId_[r] && peerPort_[pr] == port_[r]) {
+            peerRating_.valueIs(pr, rating_[r]);
+        }
+    }
+
+    /** Number of words of the infected bitmap in use on the given page. */
+    size_t pageWordCount(const size_t p) const {
+        const auto begin = p * InfectedVector::pageSize;
+        const auto end = infected_.size();
+        return end - begin < InfectedVector::pageSize ?
+            end - begin : InfectedVector::pageSize;
+    }
+
+    static U32 lowestBit(const U64 word) {
+#if defined(__GNUC__) || defined(__clang__)
+        return U32(__builtin_ctzll(word));
+#else
+        U32 bit = 0;
+        while (((word >> bit) & 1) == 0) {
+            ++bit;
+        }
+
+        return bit;
+#endif
+    }
+
+};
+
+/** Columns of a network's live table: one contiguous array each. */
+struct FlatColumns {
+    template <class T>
+    using Vector = FlatVector<T>;
+};
+
+/** Columns of a snapshot: copy-on-write pages. */
+struct PagedColumns {
+    template <class T>
+    using Vector = PagedVector<T>;
+};
+
+typedef BasicPortTable<FlatColumns> PortTable;
+
+typedef BasicPortTable<PagedColumns> PagedPortTable;
+
+#endif
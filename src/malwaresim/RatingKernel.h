@@ -0,0 +1,165 @@
+/**
+ * Vectorized tests of port ratings against a malware strength.
+ */
+
+#ifndef RATINGKERNEL_H
+#define RATINGKERNEL_H
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#   define RATINGKERNEL_SSE2
+#   include <immintrin.h>
+#endif
+
+#if defined(RATINGKERNEL_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#   define RATINGKERNEL_AVX2
+#endif
+
+/**
+ * RatingKernel compares an array of port ratings with a malware strength
+ * and produces a bitmask of the ports that let the malware through,
+ * bit i for rating i, 64 ratings to a mask word.
+ *
+ * A port blocks malware (Port::blocks) if its rating is at least
+ * the strength or equal to it within MalwareStrength::tol, that is,
+ * if the rating is above strength - tol. So a port is open exactly when
+ * its rating is at or below openThreshold(strength), a single comparison
+ * that the kernels make on several ratings at once.
+ *
+ * The AVX2 kernel compares four ratings per instruction and the SSE2
+ * kernel two; the scalar kernel is the reference and the fallback.
+ * With GCC or Clang on x86-64 the AVX2 kernel is compiled whatever
+ * the build flags, and chosen at run time if the processor has AVX2.
+ * All kernels give identical masks.
+ */
+class RatingKernel {
+public:
+
+    enum InstructionSet {
+        scalar,
+        sse2,
+        avx2
+    };
+
+
+    /** Best instruction set supported by this build and processor. */
+    static InstructionSet best() {
+#ifdef RATINGKERNEL_AVX2
+        static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+        if (hasAvx2) {
+            return avx2;
+        }
+#endif
+
+#ifdef RATINGKERNEL_SSE2
+        return sse2;
+#else
+        return scalar;
+#endif
+    }
+
+    /** Rating at or below which a port lets malware of the strength in. */
+    static double openThreshold(const MalwareStrength strength) {
+        return strength.value() - MalwareStrength::tol;
+    }
+
+
+    /**
+     * Set mask bit i, for i < n, if ratings[i] is at or below the threshold,
+     * and clear it otherwise. The mask has (n + 63) / 64 words; bits past n
+     * in the last word are cleared. The instruction set must be supported.
+     */
+    static void openMaskIs(
+        const double* const ratings, const size_t n, const double threshold,
+        U64* const mask, const InstructionSet set = best()
+    ) {
+        const auto words = n / 64;
+
+        switch (set) {
+#ifdef RATINGKERNEL_AVX2
+        case avx2:
+            avx2Words(ratings, words, threshold, mask);
+            break;
+#endif
+
+#ifdef RATINGKERNEL_SSE2
+        case sse2:
+            sse2Words(ratings, words, threshold, mask);
+            break;
+#endif
+
+        default:
+            scalarWords(ratings, words, threshold, mask);
+            break;
+        }
+
+        if (n % 64 != 0) {
+            mask[words] = scalarWord(ratings + words * 64, n % 64, threshold);
+        }
+    }
+
+private:
+
+    static U64 scalarWord(
+        const double* const ratings, const size_t n, const double threshold
+    ) {
+        U64 word = 0;
+        for (size_t i = 0; i < n; ++i) {
+            word |= U64(ratings[i] <= threshold) << i;
+        }
+
+        return word;
+    }
+
+    static void scalarWords(
+        const double* const ratings, const size_t words, const double threshold,
+        U64* const mask
+    ) {
+        for (size_t w = 0; w < words; ++w) {
+            mask[w] = scalarWord(ratings + w * 64, 64, threshold);
+        }
+    }
+
+#ifdef RATINGKERNEL_SSE2
+    static void sse2Words(
+        const double* const ratings, const size_t words, const double threshold,
+        U64* const mask
+    ) {
+        const auto t = _mm_set1_pd(threshold);
+        for (size_t w = 0; w < words; ++w) {
+            const auto r = ratings + w * 64;
+
+            U64 word = 0;
+            for (U32 i = 0; i < 64; i += 2) {
+                const auto open = _mm_cmple_pd(_mm_loadu_pd(r + i), t);
+                word |= U64(_mm_movemask_pd(open)) << i;
+            }
+
+            mask[w] = word;
+        }
+    }
+#endif
+
+#ifdef RATINGKERNEL_AVX2
+    __attribute__((target("avx2")))
+    static void avx2Words(
+        const double* const ratings, const size_t words, const double threshold,
+        U64* const mask
+    ) {
+        const auto t = _mm256_set1_pd(threshold);
+        for (size_t w = 0; w < words; ++w) {
+            const auto r = ratings + w * 64;
+
+            U64 word = 0;
+            for (U32 i = 0; i < 64; i += 4) {
+                const auto open = _mm256_cmp_pd(_mm256_loadu_pd(r + i), t, _CMP_LE_OQ);
+                word |= U64(_mm256_movemask_pd(open)) << i;
+            }
+
+            mask[w] = word;
+        }
+    }
+#endif
+
+};
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * Bounded single-producer, single-consumer queue.
+ */
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * RingBuffer passes values from one producer thread to one consumer
+ * thread in order, without locks. The producer only writes tail_ and
+ * the consumer only writes head_, each with a release store that
+ * the other side reads with an acquire load, so a value is complete
+ * before it is seen. The indices sit on separate cache lines.
+ *
+ * push and pop wait for room or for a value by sleeping on a condition
+ * variable, so a side waiting on the other, e.g. on a reader blocked
+ * in input, uses no CPU. A waiting side sets sleeping_ and checks
+ * the ring once more before it waits; push and pop check sleeping_
+ * after they move an index. The seq_cst fences on both sides make sure
+ * one of them sees the other, so no wakeup is lost. Only one side can
+ * wait at a time, since the ring cannot be both full and empty.
+ * A side that waits with push or pop is only woken by the other side's
+ * pop or push, not by tryPop or tryPush.
+ */
+template <class T, U32 capacity>
+class RingBuffer {
+public:
+
+    static_assert((capacity & (capacity - 1)) == 0, "capacity is a power of 2");
+
+
+    RingBuffer() :
+        head_(0),
+        tail_(0),
+        sleeping_(false)
+    {
+        // Nothing else to do.
+    }
+
+
+    /** Append a value if there is room. Called by the producer. */
+    bool tryPush(const T& value) {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == capacity) {
+            return false;
+        }
+
+        values_[tail % capacity] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Remove the oldest value if there is one. Called by the consumer. */
+    bool tryPop(T& value) {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = values_[head % capacity];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Whether there is no value to remove. Called by the consumer. */
+    bool empty() const {
+        return head_.load(std::memory_order_relaxed) ==
+            tail_.load(std::memory_order_acquire);
+    }
+
+    /** Append a value, waiting for room. Called by the producer. */
+    void push(const T& value) {
+        while (!tryPush(value)) {
+            sleep([this]() {
+                return tail_.load(std::memory_order_relaxed) -
+                    head_.load(std::memory_order_acquire) != capacity;
+            });
+        }
+
+        wake();
+    }
+
+    /** Remove the oldest value, waiting for one. Called by the consumer. */
+    T pop() {
+        T value;
+        while (!tryPop(value)) {
+            sleep([this]() {
+                return !empty();
+            });
+        }
+
+        wake();
+        return value;
+    }
+
+
+    RingBuffer(const RingBuffer&) = delete;
+
+    void operator =(const RingBuffer&) = delete;
+
+private:
+
+    alignas(64) std::atomic<U32> head_;
+    alignas(64) std::atomic<U32> tail_;
+    alignas(64) T values_[capacity];
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::atomic<bool> sleeping_;
+
+
+    /** Wait until ready returns true or the other side calls wake. */
+    template <class Func>
+    void sleep(const Func& ready) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (ready()) {
+            sleeping_.store(false, std::memory_order_relaxed);
+            return;
+        }
+
+        wakeup_.wait(lock, [this]() {
+            return !sleeping_.load(std::memory_order_relaxed);
+        });
+    }
+
+    /** Wake the other side if it sleeps. Called after moving an index. */
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!sleeping_.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        sleeping_.store(false, std::memory_order_relaxed);
+        wakeup_.notify_one();
+    }
+
+};
+
+#endif
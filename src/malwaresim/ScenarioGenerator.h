@@ -0,0 +1,396 @@
+/**
+ * Synthetic malware simulation scripts at scale.
+ */
+
+#ifndef SCENARIOGENERATOR_H
+#define SCENARIOGENERATOR_H
+
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+/**
+ * ScenarioGenerator writes a MalwareSim script that builds one network
+ * of deviceCount devices with the given topology, sets port ratings,
+ * starts infectionCount infections and finally removes the infected
+ * devices:
+ *
+ *     chain      device i is connected to device i + 1.
+ *     star       firewall hubs with 14 leaves each, the hubs in a chain.
+ *     tree       device i is a child of device (i - 1) / degree.
+ *     regular    random graph where every device has degree links,
+ *                made by pairing link ends at random (self links are
+ *                dropped, so a few devices have fewer).
+ *     scaleFree  preferential attachment: each new device links to
+ *                degree / 2 devices picked in proportion to their links.
+ *
+ * A device is a firewall with probability firewallFraction and otherwise
+ * a personal device; star hubs are always firewalls. A link uses the
+ * lowest free port on both devices, and no device is given more links
+ * than it has ports, so scaleFree degrees are capped at 8 or 16.
+ *
+ * Firewall ports keep their default rating, which blocks all malware.
+ * Every connected port of a personal device gets a rating drawn from
+ * the rating distribution: ratingMin, uniform between ratingMin and
+ * ratingMax, or one of the two with equal chance (bimodal). Infections
+ * have the given strength and enter the last port of a random device.
+ *
+ * Devices are named d0, d1, ... in network "net". The same settings
+ * and seed always give the same script.
+ */
+class ScenarioGenerator : public fwk::PtrInterface {
+public:
+
+    enum Topology {
+        chain,
+        star,
+        tree,
+        regular,
+        scaleFree
+    };
+
+    static const U32 topologyCount = scaleFree + 1;
+
+    static const char* name(const Topology topology) {
+        static const char* const names[] = {
+            "chain", "star", "tree", "regular", "scaleFree"
+        };
+        return names[topology];
+    }
+
+    enum RatingDistribution {
+        constant,
+        uniform,
+        bimodal
+    };
+
+
+    static Ptr<ScenarioGenerator> instanceNew() {
+        return new ScenarioGenerator();
+    }
+
+
+    Topology topology() const {
+        return topology_;
+    }
+
+    void topologyIs(const Topology topology) {
+        topology_ = topology;
+    }
+
+
+    U32 deviceCount() const {
+        return deviceCount_;
+    }
+
+    void deviceCountIs(const U32 count) {
+        deviceCount_ = count;
+    }
+
+
+    /**
+     * Children of a tree device, links of a regular device, and twice
+     * the links each scaleFree device makes. At most 7.
+     */
+    U32 degree() const {
+        return degree_;
+    }
+
+    void degreeIs(const U32 degree) {
+        degree_ = std::max<U32>(1, std::min(degree, personalPortCount - 1));
+    }
+
+
+    double firewallFraction() const {
+        return firewallFraction_;
+    }
+
+    void firewallFractionIs(const double fraction) {
+        firewallFraction_ = fraction;
+    }
+
+
+    RatingDistribution ratingDistribution() const {
+        return ratingDistribution_;
+    }
+
+    void ratingDistributionIs(const RatingDistribution distribution) {
+        ratingDistribution_ = distribution;
+    }
+
+
+    double ratingMin() const {
+        return ratingMin_;
+    }
+
+    void ratingMinIs(const double rating) {
+        ratingMin_ = rating;
+    }
+
+
+    double ratingMax() const {
+        return ratingMax_;
+    }
+
+    void ratingMaxIs(const double rating) {
+        ratingMax_ = rating;
+    }
+
+
+    U32 infectionCount() const {
+        return infectionCount_;
+    }
+
+    void infectionCountIs(const U32 count) {
+        infectionCount_ = count;
+    }
+
+
+    double strength() const {
+        return strength_;
+    }
+
+    void strengthIs(const double strength) {
+        strength_ = strength;
+    }
+
+
+    U64 seed() const {
+        return seed_;
+    }
+
+    void seedIs(const U64 seed) {
+        seed_ = seed;
+    }
+
+
+    /**
+     * Write the script and return the number of commands in it. The links
+     * and per-device state built on the way are released before returning.
+     */
+    U64 scriptOut(std::ostream& out) {
+        state_ = seed_;
+        commandCount_ = 0;
+        portsUsed_.assign(deviceCount_, 0);
+        firewall_.assign(deviceCount_, false);
+        links_.clear();
+
+        out << "Network networkNew net\n";
+        ++commandCount_;
+        if (deviceCount_ == 0) {
+            stateDel();
+            return commandCount_;
+        }
+
+        for (U32 i = 0; i < deviceCount_; ++i) {
+            firewall_[i] = topology_ == star ?
+                i % (starLeafCount + 1) == 0 : random() < firewallFraction_;
+            out << "Network net " << (firewall_[i] ? "firewallNew" : "personalNew") <<
+                " d" << i << '\n';
+            ++commandCount_;
+        }
+
+        switch (topology_) {
+        case chain:
+            for (U32 i = 1; i < deviceCount_; ++i) {
+                linkNew(i - 1, i);
+            }
+            break;
+
+        case star:
+            for (U32 i = 1; i < deviceCount_; ++i) {
+                const auto hub = i - i % (starLeafCount + 1);
+                linkNew(hub == i ? hub - starLeafCount - 1 : hub, i);
+            }
+            break;
+
+        case tree:
+            for (U32 i = 1; i < deviceCount_; ++i) {
+                linkNew((i - 1) / degree_, i);
+            }
+            break;
+
+        case regular:
+            regularNew();
+            break;
+
+        case scaleFree:
+            scaleFreeNew();
+            break;
+        }
+
+        for (const auto& link : links_) {
+            out << "Device net d" << link.device << ' ' << U32(link.port) <<
+                " connectionIs d" << link.device2 << ' ' << U32(link.port2) << '\n';
+            ++commandCount_;
+        }
+
+        for (U32 i = 0; i < deviceCount_; ++i) {
+            if (firewall_[i]) {
+                continue;
+            }
+
+            for (U32 p = 0; p < portsUsed_[i]; ++p) {
+                const auto r = rating();
+                if (r != 0.0) {
+                    out << "Device net d" << i << ' ' << p << " ratingIs " << r << '\n';
+                    ++commandCount_;
+                }
+            }
+        }
+
+        for (U32 k = 0; k < infectionCount_; ++k) {
+            const auto i = U32(random() * deviceCount_);
+            const auto port = (firewall_[i] ? firewallPortCount : personalPortCount) - 1;
+            out << "Network net infectionIs " << strength_ << " d" << i << ' ' <<
+                port << '\n';
+            ++commandCount_;
+        }
+
+        out << "Network net infectedDel\n";
+        ++commandCount_;
+
+        stateDel();
+        return commandCount_;
+    }
+
+protected:
+
+    /** Ports of the devices the script creates. */
+    static const U32 personalPortCount = 8;
+    static const U32 firewallPortCount = 16;
+
+    /** Leaves on each star hub: two hub ports link to neighbouring hubs. */
+    static const U32 starLeafCount = firewallPortCount - 2;
+
+
+    struct Link {
+        U32 device;
+        U32 device2;
+        U8 port;
+        U8 port2;
+    };
+
+
+    Topology topology_;
+    U32 deviceCount_;
+    U32 degree_;
+    double firewallFraction_;
+    RatingDistribution ratingDistribution_;
+    double ratingMin_;
+    double ratingMax_;
+    U32 infectionCount_;
+    double strength_;
+    U64 seed_;
+
+    U64 state_;
+    U64 commandCount_;
+    std::vector<U8> portsUsed_;
+    std::vector<bool> firewall_;
+    std::vector<Link> links_;
+
+
+    ScenarioGenerator() :
+        topology_(chain),
+        deviceCount_(1000),
+        degree_(4),
+        firewallFraction_(0.05),
+        ratingDistribution_(uniform),
+        ratingMin_(0.0),
+        ratingMax_(1.0),
+        infectionCount_(1),
+        strength_(0.5),
+        seed_(1),
+        state_(1),
+        commandCount_(0)
+    {
+        // Nothing else to do.
+    }
+
+
+    void stateDel() {
+        std::vector<U8>().swap(portsUsed_);
+        std::vector<bool>().swap(firewall_);
+        std::vector<Link>().swap(links_);
+    }
+
+    /** Uniform value in [0, 1) from the next step of a SplitMix64 stream. */
+    double random() {
+        auto x = (state_ += 0x9e3779b97f4a7c15ull);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return (x >> 11) * (1.0 / (U64(1) << 53));
+    }
+
+    double rating() {
+        switch (ratingDistribution_) {
+        case constant:
+            return ratingMin_;
+
+        case uniform:
+            return ratingMin_ + random() * (ratingMax_ - ratingMin_);
+
+        case bimodal:
+            return random() < 0.5 ? ratingMin_ : ratingMax_;
+        }
+
+        return ratingMin_;
+    }
+
+
+    bool portFree(const U32 i) const {
+        return portsUsed_[i] < (firewall_[i] ? firewallPortCount : personalPortCount);
+    }
+
+    /** Link the lowest free ports of two devices, if both have one. */
+    bool linkNew(const U32 a, const U32 b) {
+        if (a == b || !portFree(a) || !portFree(b)) {
+            return false;
+        }
+
+        links_.push_back(Link{a, b, portsUsed_[a]++, portsUsed_[b]++});
+        return true;
+    }
+
+    void regularNew() {
+        std::vector<U32> ends(size_t(deviceCount_) * degree_);
+        for (size_t e = 0; e < ends.size(); ++e) {
+            ends[e] = U32(e / degree_);
+        }
+
+        for (auto e = ends.size(); e > 1; --e) {
+            std::swap(ends[e - 1], ends[size_t(random() * e)]);
+        }
+
+        for (size_t e = 0; e + 1 < ends.size(); e += 2) {
+            linkNew(ends[e], ends[e + 1]);
+        }
+    }
+
+    void scaleFreeNew() {
+        const auto m = std::max<U32>(1, degree_ / 2);
+
+        // One entry per link end, so a uniform pick is by link count.
+        std::vector<U32> ends;
+        ends.reserve(size_t(deviceCount_) * m * 2);
+        ends.push_back(0);
+
+        for (U32 i = 1; i < deviceCount_; ++i) {
+            const auto before = ends.size();
+            for (U32 j = 0; j < m && j < i; ++j) {
+                for (U32 attempt = 0; attempt < 8; ++attempt) {
+                    const auto target = ends[size_t(random() * before)];
+                    if (linkNew(target, i)) {
+                        ends.push_back(target);
+                        ends.push_back(i);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+};
+
+#endif
@@ -0,0 +1,814 @@
+/**
+ * Network whose devices are spread over shards run by worker threads.
+ */
+
+#ifndef SHARDEDNETWORK_H
+#define SHARDEDNETWORK_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * ShardedNetwork spreads the devices of one logical network over
+ * shardCount shards. Each shard owns a Network, with its own device map
+ * and port table, and a worker thread that is the only thread to touch
+ * that network or its devices. A device belongs to the shard picked
+ * by a hash of its name.
+ *
+ * Commands are made by one caller thread and travel as messages to the
+ * shard that owns the device, on a single-producer, single-consumer
+ * RingBuffer per sender and shard. The caller does not wait for them;
+ * each shard applies its commands in the order they were made, and
+ * flush waits until every message has been handled. Queries and
+ * infectionIs flush first, so they see every earlier command. A worker
+ * with nothing to do sleeps on a condition variable until a message is
+ * pushed to one of its rings, and flush sleeps until the last pending
+ * message is handled.
+ *
+ * A connection between devices of the same shard is an ordinary
+ * Device::connectionIs. A connection between shards is a pair of proxies,
+ * one in each shard, naming the local device and port and the proxy
+ * at the other end; the ports themselves stay unconnected. Reconnecting
+ * a port or removing its device drops its proxy, and the shard tells
+ * the other end to drop its proxy too.
+ *
+ * An infection runs as a wave. The owning shard floods its own network
+ * (Network::infectionIs); then every proxy of a device that flood newly
+ * infected sends the malware to the proxy at the other end, and that
+ * shard lets it in on the proxy's port, floods, and so on. Proxies are
+ * kept per device, so a flood only looks at the proxies of the devices
+ * it infected. Shards flood in parallel, and the wave ends when no
+ * messages are left. A device is infected exactly when the single-network
+ * flood would infect it.
+ *
+ * The caller keeps the name and type of each device it added, so
+ * portCount, personalCount and networkDeviceCount answer without waiting
+ * for the shards, and a caller such as MalwareSim can check a command
+ * before sending it. infectedDel waits for the shards, to forget
+ * the devices they removed.
+ *
+ * Commands that name a missing device, or that the shard's network
+ * rejects, are dropped and counted in errorCount. Cloning devices is not
+ * supported across shards.
+ */
+class ShardedNetwork : public fwk::PtrInterface {
+public:
+
+    static Ptr<ShardedNetwork> instanceNew(const string& name, const U32 shardCount) {
+        return new ShardedNetwork(name, shardCount == 0 ? 1 : shardCount);
+    }
+
+
+    U32 shardCount() const {
+        return U32(shards_.size());
+    }
+
+    /** Shard that owns the device with the given name. */
+    U32 shard(const string& name) const {
+        U64 h = 14695981039346656037ull;
+        for (const auto c : name) {
+            h = (h ^ U8(c)) * 1099511628211ull;
+        }
+
+        return U32(h % shards_.size());
+    }
+
+    /**
+     * The network of shard i, after a flush. It may only be read,
+     * and only until the next command.
+     */
+    const Ptr<Network>& network(const U32 i) {
+        flush();
+        return shards_[i]->network_;
+    }
+
+
+    void personalNew(const string& name) {
+        deviceNew(personal, name);
+    }
+
+    void mobileNew(const string& name) {
+        deviceNew(mobile, name);
+    }
+
+    void firewallNew(const string& name) {
+        deviceNew(firewall, name);
+    }
+
+    void portRatingIs(const string& name, const U32 p, const MalwareStrength rating) {
+        Message m(ratingOp);
+        m.name = name;
+        m.port = p;
+        m.value = rating.value();
+        send(shard(name), m);
+    }
+
+    /** Connect port p of one device to port p2 of another. */
+    void connectionIs(
+        const string& name, const U32 p, const string& name2, const U32 p2
+    ) {
+        const auto s = shard(name);
+        const auto s2 = shard(name2);
+
+        if (s == s2) {
+            Message m(connectionOp);
+            m.name = name;
+            m.port = p;
+            m.name2 = name2;
+            m.port2 = p2;
+            send(s, m);
+            return;
+        }
+
+        const auto proxy = proxyCount_[s]++;
+        const auto proxy2 = proxyCount_[s2]++;
+
+        Message m(proxyOp);
+        m.name = name;
+        m.port = p;
+        m.proxy = proxy;
+        m.remoteShard = s2;
+        m.remoteProxy = proxy2;
+        send(s, m);
+
+        m.name = name2;
+        m.port = p2;
+        m.proxy = proxy2;
+        m.remoteShard = s;
+        m.remoteProxy = proxy;
+        send(s2, m);
+    }
+
+    /**
+     * Infect the network with malware of the given strength entering
+     * the given device on the given port, as Network::infectionIs does,
+     * and return the number of devices newly infected.
+     */
+    U32 infectionIs(const MalwareStrength strength, const string& name, const U32 p) {
+        const auto before = infectedCount();
+
+        Message m(infectionOp);
+        m.name = name;
+        m.port = p;
+        m.value = strength.value();
+        send(shard(name), m);
+
+        return infectedCount() - before;
+    }
+
+    /** Remove every infected device from every shard. */
+    void infectedDel() {
+        for (U32 s = 0; s < shardCount(); ++s) {
+            send(s, Message(infectedDelOp));
+        }
+
+        flush();
+        for (const auto& shard : shards_) {
+            for (const auto& name : shard->removed_) {
+                const auto i = devices_.find(name);
+                if (i != devices_.end()) {
+                    --typeCount_[i->second];
+                    devices_.erase(i);
+                }
+            }
+            shard->removed_.clear();
+        }
+    }
+
+
+    /**
+     * Number of ports of the device with the given name, or 0 if
+     * there is none. Does not wait for the shards.
+     */
+    U32 portCount(const string& name) const {
+        const auto i = devices_.find(name);
+        return i == devices_.end() ? 0 : portCount_[i->second];
+    }
+
+    /** Number of personal and mobile devices. Does not wait for the shards. */
+    U32 personalCount() const {
+        return typeCount_[personal] + typeCount_[mobile];
+    }
+
+    /** Number of network devices. Does not wait for the shards. */
+    U32 networkDeviceCount() const {
+        return typeCount_[firewall];
+    }
+
+
+    U32 deviceCount() {
+        flush();
+
+        U32 count = 0;
+        for (const auto& shard : shards_) {
+            count += U32(shard->network_->deviceCount());
+        }
+
+        return count;
+    }
+
+    U32 infectedCount() {
+        flush();
+
+        U32 count = 0;
+        for (const auto& shard : shards_) {
+            count += shard->network_->infectedCount();
+        }
+
+        return count;
+    }
+
+    /**
+     * Number of connections from an infected device to a healthy one,
+     * counted once from the infected end, including those between shards.
+     */
+    U64 blockedLinkCount() {
+        flush();
+
+        U64 count = 0;
+        for (const auto& shard : shards_) {
+            const auto& table = shard->network_->portTable();
+            table.infectedEach([this, &shard, &table, &count](const U32 id) {
+                const auto end = table.portBegin(id) + table.portCount(id);
+                for (auto r = table.portBegin(id); r < end; ++r) {
+                    const auto peer = table.peer(r);
+                    if (peer != PortTable::none && !table.infected(peer)) {
+                        ++count;
+                    }
+                }
+
+                const auto i = shard->deviceProxies_.find(table.device(id));
+                if (i == shard->deviceProxies_.end()) {
+                    return;
+                }
+
+                // The far end's proxy is missing if its device was.
+                for (const auto index : i->second) {
+                    const auto& proxy = shard->proxies_[index];
+                    const auto& remote = shards_[proxy.remoteShard]->proxies_;
+                    if (proxy.remoteProxy < remote.size() &&
+                        remote[proxy.remoteProxy].device != null &&
+                        remote[proxy.remoteProxy].device->healthState() != Device::infected
+                    ) {
+                        ++count;
+                    }
+                }
+            });
+        }
+
+        return count;
+    }
+
+    /** Number of live proxies, two for each connection between shards. */
+    U32 proxyCount() {
+        flush();
+
+        U32 count = 0;
+        for (const auto& shard : shards_) {
+            count += shard->proxyLiveCount_;
+        }
+
+        return count;
+    }
+
+    /** Number of commands dropped by the shards. */
+    U64 errorCount() {
+        flush();
+
+        U64 count = 0;
+        for (const auto& shard : shards_) {
+            count += shard->errorCount_;
+        }
+
+        return count;
+    }
+
+
+    /** Wait until every command has been handled. */
+    void flush() {
+        std::unique_lock<std::mutex> lock(flushMutex_);
+        flushed_.wait(lock, [this]() {
+            return pending_.load(std::memory_order_acquire) == 0;
+        });
+    }
+
+
+    ShardedNetwork(const ShardedNetwork&) = delete;
+
+    void operator =(const ShardedNetwork&) = delete;
+
+protected:
+
+    enum DeviceType {
+        personal,
+        mobile,
+        firewall
+    };
+
+    enum Op {
+        deviceOp,
+        ratingOp,
+        connectionOp,
+        proxyOp,
+        proxyDelOp,
+        infectionOp,
+        proxyInfectionOp,
+        infectedDelOp,
+        stopOp
+    };
+
+    /** A command or a message between shards. */
+    struct Message {
+        Op op;
+        DeviceType type;
+        U32 port;
+        U32 port2;
+        U32 proxy;
+        U32 remoteShard;
+        U32 remoteProxy;
+        double value;
+        string name;
+        string name2;
+
+        Message() :
+            Message(stopOp)
+        {
+            // Nothing else to do.
+        }
+
+        explicit Message(const Op o) :
+            op(o),
+            type(personal),
+            port(0),
+            port2(0),
+            proxy(0),
+            remoteShard(0),
+            remoteProxy(0),
+            value(0)
+        {
+            // Nothing else to do.
+        }
+    };
+
+    static const U32 ringCapacity = 256;
+
+    /** Arrival of an infection that did not come through a proxy. */
+    static const U32 noProxy = ~U32(0);
+
+    typedef RingBuffer<Message, ringCapacity> Ring;
+
+
+    /** One end of a connection between shards. */
+    struct Proxy {
+        Ptr<Device> device;
+        U32 port;
+        U32 remoteShard;
+        U32 remoteProxy;
+        bool dropped;
+    };
+
+    /**
+     * Shard holds a network, its proxies and its inbound rings, one from
+     * each other shard and, last, one from the caller. Messages for other
+     * shards wait in an outbox until their ring has room, so a worker
+     * never blocks on a full ring.
+     *
+     * A worker that finds its rings and outboxes empty sets sleeping_
+     * and checks its rings once more before waiting on wakeup_; a sender
+     * pushes and then checks sleeping_. The seq_cst fences on both sides
+     * make sure one of them sees the other, so no wakeup is lost.
+     */
+    class Shard {
+    public:
+
+        Shard(ShardedNetwork* const owner, const U32 index, const string& name) :
+            owner_(owner),
+            index_(index),
+            network_(Network::instanceNew(name + "-" + std::to_string(index))),
+            proxyLiveCount_(0),
+            errorCount_(0),
+            sleeping_(false)
+        {
+            network_->infectionThreadCountIs(1);
+        }
+
+
+        ShardedNetwork* owner_;
+        U32 index_;
+        Ptr<Network> network_;
+
+        std::vector< std::unique_ptr<Ring> > inbox_;
+        std::vector< std::deque<Message> > outbox_;
+
+        /**
+         * Proxies by index; a dropped proxy keeps its slot with no device.
+         * The other end may drop a proxy before its proxyOp arrives here,
+         * since that comes on the caller's ring; the slot is then marked
+         * dropped and the proxy is never made.
+         */
+        std::vector<Proxy> proxies_;
+
+        /** Names of the devices infectedDel removed, until the caller takes them. */
+        std::vector<string> removed_;
+
+        /** Indices of the live proxies of each device with any. */
+        std::unordered_map< Device*, std::vector<U32> > deviceProxies_;
+        U32 proxyLiveCount_;
+
+        U64 errorCount_;
+
+        std::thread thread_;
+
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::atomic<bool> sleeping_;
+
+
+        void run() {
+            for (;;) {
+                bool busy = false;
+                for (auto& ring : inbox_) {
+                    Message m;
+                    for (U32 i = 0; i < ringCapacity && ring->tryPop(m); ++i) {
+                        if (m.op == stopOp) {
+                            return;
+                        }
+
+                        handle(m);
+                        handled();
+                        busy = true;
+                    }
+                }
+
+                bool waiting = false;
+                for (U32 s = 0; s < outbox_.size(); ++s) {
+                    auto& out = outbox_[s];
+                    if (out.empty()) {
+                        continue;
+                    }
+
+                    auto& shard = *owner_->shards_[s];
+                    auto& ring = *shard.inbox_[index_];
+                    bool pushed = false;
+                    while (!out.empty() && ring.tryPush(out.front())) {
+                        out.pop_front();
+                        pushed = true;
+                    }
+
+                    if (pushed) {
+                        shard.wake();
+                        busy = true;
+                    }
+                    waiting = waiting || !out.empty();
+                }
+
+                if (busy) {
+                    continue;
+                }
+
+                // A full ring empties without our help; only an empty
+                // shard sleeps.
+                if (waiting) {
+                    std::this_thread::yield();
+                } else {
+                    sleep();
+                }
+            }
+        }
+
+        /** Wait until a message is pushed to one of the inbound rings. */
+        void sleep() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            for (const auto& ring : inbox_) {
+                if (!ring->empty()) {
+                    sleeping_.store(false, std::memory_order_relaxed);
+                    return;
+                }
+            }
+
+            wakeup_.wait(lock, [this]() {
+                return !sleeping_.load(std::memory_order_relaxed);
+            });
+        }
+
+        /**
+         * Push a message from the caller and wake the worker. A full ring
+         * means the worker is busy, not asleep, so the caller yields.
+         */
+        void push(const Message& m) {
+            auto& ring = *inbox_.back();
+            while (!ring.tryPush(m)) {
+                std::this_thread::yield();
+            }
+
+            wake();
+        }
+
+        /** Wake the worker if it sleeps. Called after a push to its ring. */
+        void wake() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!sleeping_.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            sleeping_.store(false, std::memory_order_relaxed);
+            wakeup_.notify_one();
+        }
+
+        /** Count a message as handled, waking flush after the last one. */
+        void handled() {
+            if (owner_->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(owner_->flushMutex_);
+                owner_->flushed_.notify_all();
+            }
+        }
+
+        void send(const U32 s, const Message& m) {
+            owner_->pending_.fetch_add(1, std::memory_order_relaxed);
+            outbox_[s].push_back(m);
+        }
+
+
+        void handle(const Message& m) {
+            try {
+                switch (m.op) {
+                case deviceOp:
+                    network_->deviceIs(deviceNew(m.type, m.name));
+                    break;
+
+                case ratingOp:
+                    if (const auto d = device(m.name)) {
+                        d->portRatingIs(m.port, m.value);
+                    }
+                    break;
+
+                case connectionOp: {
+                    const auto d = device(m.name);
+                    const auto d2 = device(m.name2);
+                    if (d != null && d2 != null) {
+                        proxyDel(d.ptr(), m.port);
+                        proxyDel(d2.ptr(), m.port2);
+                        d->connectionIs(m.port, d2, m.port2);
+                    }
+                    break;
+                }
+
+                case proxyOp:
+                    if (const auto d = device(m.name)) {
+                        proxyNewIs(d, m);
+                    }
+                    break;
+
+                case proxyDelOp:
+                    if (proxies_.size() <= m.proxy) {
+                        proxies_.resize(m.proxy + 1);
+                    }
+
+                    if (proxies_[m.proxy].device != null) {
+                        proxyDrop(m.proxy);
+                    } else {
+                        proxies_[m.proxy].dropped = true;
+                    }
+                    break;
+
+                case infectionOp:
+                    if (const auto d = device(m.name)) {
+                        infectionIs(m, d, m.port, noProxy);
+                    }
+                    break;
+
+                case proxyInfectionOp:
+                    if (m.proxy < proxies_.size() && proxies_[m.proxy].device != null) {
+                        const auto& proxy = proxies_[m.proxy];
+                        infectionIs(m, proxy.device, proxy.port, m.proxy);
+                    }
+                    break;
+
+                case infectedDelOp:
+                    for (const auto& d : network_->infectedDel()) {
+                        removed_.push_back(d->name());
+
+                        const auto i = deviceProxies_.find(d.ptr());
+                        if (i == deviceProxies_.end()) {
+                            continue;
+                        }
+
+                        for (const auto p : std::vector<U32>(i->second)) {
+                            proxyDel(d.ptr(), proxies_[p].port);
+                        }
+                    }
+                    break;
+
+                case stopOp:
+                    break;
+                }
+            } catch (const fwk::Exception&) {
+                ++errorCount_;
+            } catch (const std::exception&) {
+                ++errorCount_;
+            }
+        }
+
+        Ptr<Device> device(const string& name) {
+            const auto d = network_->device(name);
+            if (d == null) {
+                ++errorCount_;
+            }
+
+            return d;
+        }
+
+        static Ptr<Device> deviceNew(const DeviceType type, const string& name) {
+            switch (type) {
+            case mobile:
+                return MobileDevice::instanceNew(name);
+
+            case firewall:
+                return FirewallDevice::instanceNew(name);
+
+            default:
+                return PersonalDevice::instanceNew(name);
+            }
+        }
+
+        void proxyNewIs(const Ptr<Device>& d, const Message& m) {
+            if (m.port >= d->portCount()) {
+                ++errorCount_;
+                return;
+            }
+
+            proxyDel(d.ptr(), m.port);
+            d->availablePortIsTrue(m.port);
+
+            if (proxies_.size() <= m.proxy) {
+                proxies_.resize(m.proxy + 1);
+            } else if (proxies_[m.proxy].dropped) {
+                return;
+            }
+
+            proxies_[m.proxy] = Proxy{ d, m.port, m.remoteShard, m.remoteProxy, false };
+            deviceProxies_[d.ptr()].push_back(m.proxy);
+            ++proxyLiveCount_;
+        }
+
+        /**
+         * Drop the proxy on port p of device d, if there is one,
+         * and tell the other end to drop its proxy.
+         */
+        void proxyDel(Device* const d, const U32 p) {
+            const auto i = deviceProxies_.find(d);
+            if (i == deviceProxies_.end()) {
+                return;
+            }
+
+            for (const auto index : i->second) {
+                const auto& proxy = proxies_[index];
+                if (proxy.port == p) {
+                    Message m(proxyDelOp);
+                    m.proxy = proxy.remoteProxy;
+                    send(proxy.remoteShard, m);
+
+                    proxyDrop(index);
+                    return;
+                }
+            }
+        }
+
+        /** Drop the live proxy with the given index, on this side only. */
+        void proxyDrop(const U32 index) {
+            auto& proxy = proxies_[index];
+            const auto i = deviceProxies_.find(proxy.device.ptr());
+            auto& indices = i->second;
+            indices.erase(std::find(indices.begin(), indices.end(), index));
+            if (indices.empty()) {
+                deviceProxies_.erase(i);
+            }
+
+            proxy.device = null;
+            proxy.dropped = true;
+            --proxyLiveCount_;
+        }
+
+        /**
+         * Flood from port p of device d, which the malware entered through
+         * proxy arrival or, if that is noProxy, from the caller; then send
+         * it on through every other proxy of each device the flood infected.
+         */
+        void infectionIs(
+            const Message& m, const Ptr<Device>& d, const U32 p, const U32 arrival
+        ) {
+            if (p >= d->portCount()) {
+                ++errorCount_;
+                return;
+            }
+
+            for (const auto infected : network_->infectionIs(m.value, d, p)) {
+                const auto i = deviceProxies_.find(infected);
+                if (i == deviceProxies_.end()) {
+                    continue;
+                }
+
+                for (const auto index : i->second) {
+                    if (index == arrival) {
+                        continue;
+                    }
+
+                    const auto& proxy = proxies_[index];
+                    Message out(proxyInfectionOp);
+                    out.proxy = proxy.remoteProxy;
+                    out.value = m.value;
+                    send(proxy.remoteShard, out);
+                }
+            }
+        }
+
+    };
+
+
+    std::vector< std::unique_ptr<Shard> > shards_;
+
+    /** Next proxy index in each shard, assigned by the caller. */
+    std::vector<U32> proxyCount_;
+
+    /** Messages sent and not yet handled. */
+    alignas(64) std::atomic<U64> pending_;
+
+    std::mutex flushMutex_;
+    std::condition_variable flushed_;
+
+    /** Type of each device the caller added, and counts by type. */
+    std::unordered_map<string, DeviceType> devices_;
+    U32 typeCount_[3];
+
+    /** Ports of a device of each type. */
+    U32 portCount_[3];
+
+
+    ShardedNetwork(const string& name, const U32 shardCount) :
+        proxyCount_(shardCount, 0),
+        pending_(0),
+        typeCount_()
+    {
+        for (const auto type : { personal, mobile, firewall }) {
+            portCount_[type] = U32(Shard::deviceNew(type, name)->portCount());
+        }
+
+        for (U32 s = 0; s < shardCount; ++s) {
+            shards_.emplace_back(new Shard(this, s, name));
+        }
+
+        for (const auto& shard : shards_) {
+            for (U32 s = 0; s <= shardCount; ++s) {
+                shard->inbox_.emplace_back(new Ring());
+            }
+            shard->outbox_.resize(shardCount);
+        }
+
+        for (const auto& shard : shards_) {
+            shard->thread_ = std::thread(&Shard::run, shard.get());
+        }
+    }
+
+    ~ShardedNetwork() {
+        flush();
+        for (const auto& shard : shards_) {
+            shard->push(Message(stopOp));
+        }
+
+        for (const auto& shard : shards_) {
+            shard->thread_.join();
+        }
+    }
+
+
+    /** Send a command from the caller to shard s. */
+    void send(const U32 s, const Message& m) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        shards_[s]->push(m);
+    }
+
+    void deviceNew(const DeviceType type, const string& name) {
+        if (devices_.emplace(name, type).second) {
+            ++typeCount_[type];
+        }
+
+        Message m(deviceOp);
+        m.name = name;
+        m.type = type;
+        send(shard(name), m);
+    }
+
+};
+
+#endif
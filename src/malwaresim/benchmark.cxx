@@ -0,0 +1,408 @@
+//
+// Benchmark of the Malware Simulation on generated scenarios.
+//
+
+#include "fwk/fwk.h"
+
+#include "MalwareStrength.h"
+#include "Port.h"
+#include "FlatVector.h"
+#include "PagedVector.h"
+#include "RingBuffer.h"
+#include "RatingKernel.h"
+#include "PortTable.h"
+#include "ComponentIndex.h"
+#include "Device.h"
+#include "InfectionEngine.h"
+#include "Network.h"
+#include "InfectionTrials.h"
+#include "NetworkScenario.h"
+#include "NetworkTracker.h"
+#include "NetworkJournal.h"
+#include "InfectionSpread.h"
+#include "ShardedNetwork.h"
+#include "MalwareScript.h"
+#include "MalwareSim.h"
+#include "ScenarioGenerator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+using fwk::Ptr;
+
+
+static void usage() {
+    cerr << "usage: benchmark [-t topology] [-n maxDevices] [-m minDevices]\n"
+        "                 [-f firewallFraction] [-r constant|uniform|bimodal]\n"
+        "                 [-d degree] [-i infections] [-s seed] [-p maxShards]\n"
+        "                 [-j] [-w]\n"
+        "topology is chain, star, tree, regular or scaleFree (default all).\n"
+        "Runs scenarios of minDevices, 10 * minDevices, ... up to maxDevices\n"
+        "devices (default 1000 to 100000) and prints wall time, commands\n"
+        "per second, peak resident memory and script errors of each run.\n"
+        "With -p, each script is also run by the interpreter on ShardedNetworks\n"
+        "of 1, 2, 4, ... up to maxShards shards, for scaling with the number\n"
+        "of cores.\n"
+        "With -j, each script is instead run on a Network with a\n"
+        "NetworkJournal, and the time to record it and to rebuild the final\n"
+        "network from the journal is printed next to the interpreter's time.\n"
+        "With -w, writes the script for maxDevices devices to standard\n"
+        "output instead.\n";
+}
+
+
+//
+// What a child process reports about its run of a script.
+//
+struct RunResult {
+    double seconds;
+    U64 errors;
+    U64 events;
+    double rebuildSeconds;
+};
+
+//
+// How a child process runs a script.
+//
+enum RunMode {
+    interpreterRun,
+    shardedRun,
+    journalRun
+};
+
+//
+// Gives each network a script creates a NetworkJournal, and keeps
+// the last one.
+//
+class JournalAttacher : public MalwareSim::Notifiee {
+public:
+
+    Ptr<NetworkJournal> journal;
+
+    void onNetworkNew(const Ptr<Network>& network) override {
+        journal = NetworkJournal::instanceNew(network);
+    }
+};
+
+//
+// Run a generated script in a MalwareSim, whose stats and error messages
+// are formatted as usual but discarded; errors are counted. A shardCount
+// other than 0 runs it on ShardedNetworks of that many shards.
+//
+static bool simEval(const char* const path, const U32 shardCount, U64& errors) {
+    std::ostream discard(nullptr);
+    const auto sim = MalwareSim::instanceNew(discard, discard);
+    sim->shardCountIs(shardCount);
+    const bool ok = sim->evalFile(path);
+    errors = sim->errorCount();
+    return ok;
+}
+
+//
+// Run a generated script in a MalwareSim whose network records
+// a NetworkJournal, then rebuild the final network from the journal.
+// The time to run is result.seconds; a rebuilt network that differs
+// in its device or infected count is an error.
+//
+static bool journalEval(const char* const path, RunResult& result) {
+    std::ostream discard(nullptr);
+    const auto sim = MalwareSim::instanceNew(discard, discard);
+    JournalAttacher attacher;
+    attacher.notifierIs(sim.ptr());
+
+    const auto start = std::chrono::steady_clock::now();
+    if (!sim->evalFile(path)) {
+        return false;
+    }
+    const auto recorded = std::chrono::steady_clock::now();
+
+    result.errors = sim->errorCount();
+    if (attacher.journal == null) {
+        ++result.errors;
+        return true;
+    }
+
+    const auto& journal = attacher.journal;
+    const auto rebuilt = journal->networkNew("replay", journal->eventCount());
+    const std::chrono::duration<double> rebuild =
+        std::chrono::steady_clock::now() - recorded;
+    const std::chrono::duration<double> record = recorded - start;
+
+    result.seconds = record.count();
+    result.rebuildSeconds = rebuild.count();
+    result.events = journal->eventCount();
+    if (rebuilt->deviceCount() != journal->notifier()->deviceCount() ||
+        rebuilt->infectedCount() != journal->notifier()->infectedCount()
+    ) {
+        ++result.errors;
+    }
+
+    return true;
+}
+
+//
+// Run the script at path in a child process, so that its peak resident
+// memory is its own; the caller releases what it no longer needs first,
+// since the child starts with the caller's resident pages. The script
+// runs as mode says, on shardCount shards for shardedRun. Return false
+// if the child failed.
+//
+static bool scriptRun(
+    const char* const path, const RunMode mode, const U32 shardCount,
+    RunResult& result, long& peakKib
+) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    const auto pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+
+        const auto start = std::chrono::steady_clock::now();
+        bool ok;
+        result = RunResult{0, 0, 0, 0};
+        if (mode == interpreterRun) {
+            ok = simEval(path, 0, result.errors);
+        } else if (mode == shardedRun) {
+            ok = simEval(path, shardCount, result.errors);
+        } else {
+            ok = journalEval(path, result);
+        }
+
+        if (mode != journalRun) {
+            const std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            result.seconds = elapsed.count();
+        }
+        const bool sent = write(fds[1], &result, sizeof(result)) == sizeof(result);
+        _exit(ok && sent ? 0 : 1);
+    }
+
+    close(fds[1]);
+    const bool received = read(fds[0], &result, sizeof(result)) == sizeof(result);
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        return false;
+    }
+
+    peakKib = usage.ru_maxrss;
+    return received && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+int main(int argc, const char* argv[]) {
+    const auto generator = ScenarioGenerator::instanceNew();
+
+    int topology = -1;
+    U32 minDevices = 1000;
+    U32 maxDevices = 100000;
+    U32 maxShards = 0;
+    bool journal = false;
+    bool scriptOnly = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "-w") {
+            scriptOnly = true;
+            continue;
+        }
+
+        if (arg == "-j") {
+            journal = true;
+            continue;
+        }
+
+        if (i + 1 == argc || arg.size() != 2 || arg[0] != '-') {
+            usage();
+            return 1;
+        }
+
+        const string value = argv[++i];
+        switch (arg[1]) {
+        case 't':
+            for (U32 t = 0; t < ScenarioGenerator::topologyCount; ++t) {
+                if (value == ScenarioGenerator::name(ScenarioGenerator::Topology(t))) {
+                    topology = int(t);
+                }
+            }
+
+            if (topology < 0) {
+                usage();
+                return 1;
+            }
+            break;
+
+        case 'n':
+            maxDevices = U32(std::strtoul(value.c_str(), null, 10));
+            break;
+
+        case 'm':
+            minDevices = U32(std::strtoul(value.c_str(), null, 10));
+            break;
+
+        case 'f':
+            generator->firewallFractionIs(std::strtod(value.c_str(), null));
+            break;
+
+        case 'r':
+            if (value == "constant") {
+                generator->ratingDistributionIs(ScenarioGenerator::constant);
+            } else if (value == "uniform") {
+                generator->ratingDistributionIs(ScenarioGenerator::uniform);
+            } else if (value == "bimodal") {
+                generator->ratingDistributionIs(ScenarioGenerator::bimodal);
+            } else {
+                usage();
+                return 1;
+            }
+            break;
+
+        case 'd':
+            generator->degreeIs(U32(std::strtoul(value.c_str(), null, 10)));
+            break;
+
+        case 'i':
+            generator->infectionCountIs(U32(std::strtoul(value.c_str(), null, 10)));
+            break;
+
+        case 's':
+            generator->seedIs(std::strtoull(value.c_str(), null, 10));
+            break;
+
+        case 'p':
+            maxShards = U32(std::strtoul(value.c_str(), null, 10));
+            break;
+
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (scriptOnly) {
+        generator->topologyIs(ScenarioGenerator::Topology(topology < 0 ? 0 : topology));
+        generator->deviceCountIs(maxDevices);
+        generator->scriptOut(cout);
+        return 0;
+    }
+
+    if (journal) {
+        std::printf(
+            "%-10s %10s %10s %9s %10s %9s %9s %10s %8s\n",
+            "topology", "devices", "commands", "script s", "events", "record s",
+            "rebuild s", "peak KiB", "errors"
+        );
+    } else {
+        std::printf(
+            "%-10s %10s %6s %10s %9s %12s %10s %8s\n",
+            "topology", "devices", "shards", "commands", "seconds", "commands/s",
+            "peak KiB", "errors"
+        );
+    }
+
+    for (U32 t = 0; t < ScenarioGenerator::topologyCount; ++t) {
+        if (topology >= 0 && int(t) != topology) {
+            continue;
+        }
+
+        generator->topologyIs(ScenarioGenerator::Topology(t));
+        const auto name = ScenarioGenerator::name(ScenarioGenerator::Topology(t));
+        for (U64 n = std::max<U32>(1, minDevices); n <= maxDevices; n *= 10) {
+            generator->deviceCountIs(U32(n));
+
+            char path[] = "/tmp/malwaresim-XXXXXX";
+            const int fd = mkstemp(path);
+            if (fd < 0) {
+                cerr << "Error creating a temporary file" << endl;
+                return 1;
+            }
+            close(fd);
+
+            U64 commands;
+            {
+                std::ofstream out(path);
+                commands = generator->scriptOut(out);
+            }
+
+            if (journal) {
+                RunResult script = {0, 0, 0, 0};
+                RunResult result = {0, 0, 0, 0};
+                long peakKib = 0;
+                if (!scriptRun(path, interpreterRun, 0, script, peakKib) ||
+                    !scriptRun(path, journalRun, 0, result, peakKib)
+                ) {
+                    std::printf(
+                        "%-10s %10llu %10llu %9s\n", name, (unsigned long long)n,
+                        (unsigned long long)commands, "failed"
+                    );
+                } else {
+                    std::printf(
+                        "%-10s %10llu %10llu %9.3f %10llu %9.3f %9.3f %10ld %8llu\n",
+                        name, (unsigned long long)n, (unsigned long long)commands,
+                        script.seconds, (unsigned long long)result.events,
+                        result.seconds, result.rebuildSeconds, peakKib,
+                        (unsigned long long)(script.errors + result.errors)
+                    );
+                    std::fflush(stdout);
+                }
+
+                unlink(path);
+                continue;
+            }
+
+            // Shard count 0 is the interpreter on a single Network.
+            for (U32 shards = 0; shards <= maxShards; shards = shards == 0 ? 1 : 2 * shards) {
+                char shardText[16] = "-";
+                if (shards != 0) {
+                    std::snprintf(shardText, sizeof(shardText), "%u", shards);
+                }
+
+                RunResult result = {0, 0, 0, 0};
+                long peakKib = 0;
+                const auto mode = shards == 0 ? interpreterRun : shardedRun;
+                if (!scriptRun(path, mode, shards, result, peakKib)) {
+                    std::printf(
+                        "%-10s %10llu %6s %10llu %9s\n", name, (unsigned long long)n,
+                        shardText, (unsigned long long)commands, "failed"
+                    );
+                    continue;
+                }
+
+                std::printf(
+                    "%-10s %10llu %6s %10llu %9.3f %12.0f %10ld %8llu\n", name,
+                    (unsigned long long)n, shardText, (unsigned long long)commands,
+                    result.seconds, commands / result.seconds, peakKib,
+                    (unsigned long long)result.errors
+                );
+                std::fflush(stdout);
+            }
+
+            unlink(path);
+        }
+    }
+
+    return 0;
+}
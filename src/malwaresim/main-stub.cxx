@@ -8,7 +8,13 @@
 
 #include "MalwareStrength.h"
 #include "Port.h"
+#include "FlatVector.h"
+#include "PagedVector.h"
+#include "RatingKernel.h"
+#include "PortTable.h"
+#include "ComponentIndex.h"
 #include "Device.h"
+#include "InfectionEngine.h"
 #include "Network.h"
 
 #include <iostream>
@@ -0,0 +1,63 @@
+//
+// Main program for Malware Simulation problem.
+//
+
+#include "fwk/fwk.h"
+
+#include "MalwareStrength.h"
+#include "Port.h"
+#include "FlatVector.h"
+#include "PagedVector.h"
+#include "RingBuffer.h"
+#include "RatingKernel.h"
+#include "PortTable.h"
+#include "ComponentIndex.h"
+#include "Device.h"
+#include "InfectionEngine.h"
+#include "Network.h"
+#include "InfectionTrials.h"
+#include "NetworkScenario.h"
+#include "NetworkTracker.h"
+#include "NetworkJournal.h"
+#include "InfectionSpread.h"
+#include "ShardedNetwork.h"
+#include "MalwareScript.h"
+#include "MalwareSim.h"
+
+#include <iostream>
+
+using std::cin;
+using std::cout;
+using std::endl;
+
+using fwk::Ptr;
+
+
+//
+// The main program takes one argument, which is the file name with the rules.
+// The rules are then executed and the appropriate statistics are printed
+// to the console.
+//
+int main(int argc, const char* argv[]) {
+    if (argc <= 1) {
+        cout << "Missing input file" << endl;
+        return 1;
+    }
+
+    if (argc > 2) {
+        cout << "Extraneous arguments after input file" << endl;
+        return 1;
+    }
+
+    string arg = argv[1];
+
+    const auto sim = MalwareSim::instanceNew();
+
+    if (arg == "-") {
+        sim->evalStream(cin);
+    } else if (!sim->evalFile(arg)) {
+        cout << "Error opening " << arg << endl;
+    }
+
+    return 0;
+}
@@ -30,16 +30,30 @@ bool isInstanceOf(const Ptr<T> p) {
     return false;
 }
 
+/**
+ * Log an error through the asynchronous fwk::Logger. Messages are rate
+ * limited per call site, identified by this function's return address.
+ */
+_noinline
 void logError(ErrorLevel errorLevel, const string& err) {
+#if defined(__GNUC__) || defined(__clang__)
+    const void* const site = __builtin_return_address(0);
+#else
+    const void* const site = null;
+#endif
+
+    auto& logger = fwk::Logger::instance();
     switch(errorLevel) {
         case WARNING: 
-            cerr << "[WARNING]: " << err << endl;
+            logger.messageNew(site, errorLevel, "[WARNING]: ", err);
             break;
         case ERROR:
-            cerr << "[ERROR]: " << err << endl;
+            logger.messageNew(site, errorLevel, "[ERROR]: ", err);
             break;
         default:
-            cerr << "[INTERNAL ERROR]: Unexpected error level: " << errorLevel << endl;
+            logger.messageNew(site, errorLevel, "[INTERNAL ERROR]: ",
+                "Unexpected error level: " + std::to_string(errorLevel)
+            );
     }
 }
 
@@ -5,8 +5,13 @@
 #include "InstanceManager.h"
 #include "TravelNetworkManager.h"
 
+#include <errno.h>
+#include <limits.h>
 #include <numeric>
 #include <sstream>
+#include <stdlib.h>
+
+using fwk::Result;
 
 using std::cerr;
 using std::cout;
@@ -26,14 +31,78 @@ const string getEntityName(Ptr<NamedInterface> entity) {
     return "";
 } 
 
-double tryConvertStrToNonNegDouble(const string& str) {
-    stringstream ss(str);
-    double value;
-    if (ss >> value) {
-        return value;
+/**
+ * Parse the number at the start of the given string without throwing.
+ * Only decimal numbers are accepted, as with stream extraction; strtod
+ * would also take "nan", "inf" and hexadecimal numbers.
+ */
+Result<double> tryParseDouble(const string& str) {
+    const auto begin = str.c_str();
+    char* end = null;
+    const double value = strtod(begin, &end);
+    if (end == begin) {
+        return Result<double>::errorNew("Value is not a number");
+    }
+
+    for (auto c = begin; c != end; ++c) {
+        if (isalpha(*c) && *c != 'e' && *c != 'E') {
+            return Result<double>::errorNew("Value is not a number");
+        }
+    }
+
+    return value;
+}
+
+/**
+ * Parse the number at the start of the given string without throwing and
+ * truncate it to an integer, so that "1e2" is 100 and "12.7" is 12.
+ */
+Result<int> tryParseDoubleAsInt(const string& str) {
+    const auto number = tryParseDouble(str);
+    if (!number.ok()) {
+        return Result<int>::errorNew(number.error());
+    }
+
+    if (!(number.value() > INT_MIN - 1.0 && number.value() < INT_MAX + 1.0)) {
+        return Result<int>::errorNew("Value is out of range");
+    }
+
+    return int(number.value());
+}
+
+/**
+ * Parse the integer at the start of the given string without throwing.
+ */
+Result<int> tryParseInt(const string& str) {
+    const auto begin = str.c_str();
+    char* end = null;
+    errno = 0;
+    const long value = strtol(begin, &end, 10);
+    if (end == begin) {
+        return Result<int>::errorNew("Value is not a number");
+    }
+
+    if (errno == ERANGE || value < INT_MIN || value > INT_MAX) {
+        return Result<int>::errorNew("Value is out of range");
+    }
+
+    return int(value);
+}
+
+/**
+ * Make a value of type T from a parsed number, passing a parse error through.
+ */
+template <class T, class RepType>
+Result<T> tryMakeValue(const Result<RepType>& number) {
+    if (!number.ok()) {
+        return Result<T>::errorNew(number.error());
     }
 
-    return -1; // Indicates erroneous output
+    return T::tryMake(number.value());
+}
+
+const string invalidValueMessage(const char* const error, const string& value) {
+    return string(error) + " ('" + value + "')";
 }
 
 //=======================================================
@@ -117,9 +186,10 @@ protected:
         int segmentNumber(const string& name) {
             if (name.substr(0, segmentStrlen) == segmentStr) {
                 auto tmp = name.substr(segmentStrlen, name.length() - segmentStrlen);
-                try {
-                    return std::stoi(tmp);
-                } catch (std::invalid_argument& e) { }
+                const auto number = tryParseInt(tmp);
+                if (number.ok()) {
+                    return number.value();
+                }
             }
 
             return -1;
@@ -152,31 +222,31 @@ protected:
          _noinline
         void attributeIs(const string& name, const string& value) {
             if (segment_ != null) {
-                try {
-                    if (name == "source") {
-                        const auto location = travelManager_->location(value);
-                        if (location != null) {
-                            segment_->sourceIs(location);
-                            return;
-                        }
-                        
-                        logError(WARNING, "Specified location '" + value + "' does not exist. Skipping command.");
-                    } else if (name == "destination") {
-                        const auto location = travelManager_->location(value);
-                        if (location != null) {
-                            segment_->destinationIs(location);
-                            return;
-                        }
-
-                        logError(WARNING, "Specified location '" + value + "' does not exist. Skipping command.");
-                    } else if (name == "length") {
-                        auto length = Miles(tryConvertStrToNonNegDouble(value));
-                        segment_->lengthIs(length);
+                if (name == "source") {
+                    const auto location = travelManager_->location(value);
+                    if (location != null) {
+                        segment_->sourceIs(location);
+                        return;
+                    }
+
+                    logError(WARNING, "Specified location '" + value + "' does not exist. Skipping command.");
+                } else if (name == "destination") {
+                    const auto location = travelManager_->location(value);
+                    if (location != null) {
+                        segment_->destinationIs(location);
+                        return;
+                    }
+
+                    logError(WARNING, "Specified location '" + value + "' does not exist. Skipping command.");
+                } else if (name == "length") {
+                    const auto length = tryMakeValue<Miles>(tryParseDouble(value));
+                    if (length.ok()) {
+                        segment_->lengthIs(length.value());
                     } else {
-                        logError(WARNING, "Invalid attribute ('" + name + "') specified for Segment. Skipping command.");
+                        logError(WARNING, invalidValueMessage(length.error(), value));
                     }
-                } catch (const fwk::RangeException& e) {
-                    logError(WARNING, e.what());
+                } else {
+                    logError(WARNING, "Invalid attribute ('" + name + "') specified for Segment. Skipping command.");
                 }
             } else {
                 logError(WARNING, "Internal Error in attributeIs() within SegmentInstance. [segment_ == null]");
@@ -233,19 +303,29 @@ protected:
         _noinline
         void attributeIs(const string& name, const string& value) {
             if (vehicle_ != null) {
-                try {
-                   if (name == "capacity") {
-                        //vehicle_->capacityIs(strToInt(value));
-                        vehicle_->capacityIs(std::stoi(value));
-                    } else if (name == "cost") {
-                        vehicle_->costIs(tryConvertStrToNonNegDouble(value));
-                    } else if (name == "speed") {
-                        vehicle_->speedIs(tryConvertStrToNonNegDouble(value));
+                if (name == "capacity") {
+                    const auto capacity = tryMakeValue<PassengerCount>(tryParseInt(value));
+                    if (capacity.ok()) {
+                        vehicle_->capacityIs(capacity.value());
                     } else {
-                        logError(WARNING, "Invalid attribute ('" + name + "') specified for Vehicle. Skipping command.");
-                    } 
-                } catch (const fwk::RangeException& e) {
-                    logError(WARNING, e.what());
+                        logError(WARNING, invalidValueMessage(capacity.error(), value));
+                    }
+                } else if (name == "cost") {
+                    const auto cost = tryMakeValue<DollarsPerMile>(tryParseDouble(value));
+                    if (cost.ok()) {
+                        vehicle_->costIs(cost.value());
+                    } else {
+                        logError(WARNING, invalidValueMessage(cost.error(), value));
+                    }
+                } else if (name == "speed") {
+                    const auto speed = tryMakeValue<MilesPerHour>(tryParseDoubleAsInt(value));
+                    if (speed.ok()) {
+                        vehicle_->speedIs(speed.value());
+                    } else {
+                        logError(WARNING, invalidValueMessage(speed.error(), value));
+                    }
+                } else {
+                    logError(WARNING, "Invalid attribute ('" + name + "') specified for Vehicle. Skipping command.");
                 }
             } else {
                 logError(WARNING, "Internal Error in attributeIs() within VehicleInstance. [vehicle_ == null]");
@@ -2,50 +2,55 @@
 #ifndef VALUE_TYPES_H
 #define VALUE_TYPES_H
 
+#include <limits>
+
+using fwk::Result;
+using fwk::TolerantEquality;
 
 //===============================================================
 // DollarsPerMile Type
 //===============================================================
 
 class Vehicle;
-class DollarsPerMile : public Ordinal<Vehicle, double> {
+class DollarsPerMile : public Ordinal<Vehicle, double, TolerantEquality> {
 public:
 
-	static constexpr double tolerance = 1e-4;
-
-	DollarsPerMile(const double value = 0) :
-		Ordinal(value)
+	constexpr DollarsPerMile(const double value = 0) :
+		Ordinal(checked(value))
 	{
-		if (value < 0) {
-			throw fwk::RangeException("DollarsPerMile cannot be negative");
-		}
+		// Nothing else to do
 	}
 
-	DollarsPerMile(const Ordinal<Vehicle, double>& c) :
-		DollarsPerMile(c.value()) 
+	constexpr DollarsPerMile(const Ordinal<Vehicle, double, TolerantEquality>& c) :
+		DollarsPerMile(c.value())
 	{
 		// Nothing else to do
 	}
 
-	DollarsPerMile(const DollarsPerMile& cost) :
-		DollarsPerMile(cost.value_)
-	{
-		// Nothing else to do.
+	/**
+	 * Return a DollarsPerMile for the given value, or an error instead
+	 * of throwing if the value is out of range.
+	 */
+	static constexpr Result<DollarsPerMile> tryMake(const double value) {
+		return invalid(value) != null ?
+			Result<DollarsPerMile>::errorNew(invalid(value)) :
+			Result<DollarsPerMile>(DollarsPerMile(value));
 	}
 
-	double value() const {
-		return value_;
-	}
+private:
 
-	/** Test for equality using a builtin tolerance. */
-	virtual bool operator ==(const DollarsPerMile& cost) {
-		return (value_ < cost.value_ + tolerance) && (value_ > cost.value_ - tolerance);
+	/** Reason the given value is out of range, or null if it is valid. */
+	static constexpr const char* invalid(const double value) {
+		return value < 0 ? "DollarsPerMile cannot be negative" :
+			!(value <= std::numeric_limits<double>::max()) ? "DollarsPerMile must be a finite number" :
+			null;
 	}
 
-	/** Test for inequality using a builtin tolerance. */
-    virtual bool operator !=(const DollarsPerMile& cost) const {
-        return (value_ >= cost.value_ + tolerance) || (value_ <= cost.value_ - tolerance);
-    }
+	static constexpr double checked(const double value) {
+		return invalid(value) != null ?
+			throw fwk::RangeException(invalid(value)) :
+			value;
+	}
 };
 
 //===============================================================
@@ -53,44 +58,45 @@ public:
 //===============================================================
 
 class Length {};
-class Miles : public Ordinal<Length, double> {
+class Miles : public Ordinal<Length, double, TolerantEquality> {
 public:
 
-	static constexpr double tolerance = 1e-4;
-
-	Miles(const double value = 0) :
-		Ordinal(value)
+	constexpr Miles(const double value = 0) :
+		Ordinal(checked(value))
 	{
-		if (value < 0) {
-			throw fwk::RangeException("Miles cannot be negative");
-		}
+		// Nothing else to do
 	}
 
-	Miles(const Ordinal<Length, double>& m) :
-		Miles(m.value()) 
+	constexpr Miles(const Ordinal<Length, double, TolerantEquality>& m) :
+		Miles(m.value())
 	{
 		// Nothing else to do
 	}
 
-	Miles(const Miles& m) :
-		Miles(m.value_)
-	{
-		// Nothing else to do.
+	/**
+	 * Return a Miles for the given value, or an error instead
+	 * of throwing if the value is out of range.
+	 */
+	static constexpr Result<Miles> tryMake(const double value) {
+		return invalid(value) != null ?
+			Result<Miles>::errorNew(invalid(value)) :
+			Result<Miles>(Miles(value));
 	}
 
-	double value() const {
-		return value_;
-	}
+private:
 
-	/** Test for equality using a builtin tolerance. */
-	virtual bool operator ==(const Miles& m) {
-		return (value_ < m.value_ + tolerance) && (value_ > m.value_ - tolerance);
+	/** Reason the given value is out of range, or null if it is valid. */
+	static constexpr const char* invalid(const double value) {
+		return value < 0 ? "Miles cannot be negative" :
+			!(value <= std::numeric_limits<double>::max()) ? "Miles must be a finite number" :
+			null;
 	}
 
-	/** Test for inequality using a builtin tolerance. */
-    virtual bool operator !=(const Miles& m) const {
-        return (value_ >= m.value_ + tolerance) || (value_ <= m.value_ - tolerance);
-    }
+	static constexpr double checked(const double value) {
+		return invalid(value) != null ?
+			throw fwk::RangeException(invalid(value)) :
+			value;
+	}
 };
 
 //===============================================================
@@ -101,25 +107,40 @@ class Speed {};
 class MilesPerHour : public Ordinal<Speed, int> {
 public:
 
-	MilesPerHour(const int value = 0) :
-		Ordinal(value)
+	constexpr MilesPerHour(const int value = 0) :
+		Ordinal(checked(value))
 	{
-		if (value < 0) {
-			throw fwk::RangeException("MilesPerHour cannot be negative ('" + std::to_string(value) + "')");
-		}
+		// Nothing else to do
 	}
 
-	MilesPerHour(const Ordinal<Speed, int>& c) :
-		MilesPerHour(c.value()) 
+	constexpr MilesPerHour(const Ordinal<Speed, int>& c) :
+		MilesPerHour(c.value())
 	{
 		// Nothing else to do
 	}
 
-	MilesPerHour(const MilesPerHour& m):
-		MilesPerHour(m.value_)
-	{
-		// Nothing else to do
-	}	
+	/**
+	 * Return a MilesPerHour for the given value, or an error instead
+	 * of throwing if the value is out of range.
+	 */
+	static constexpr Result<MilesPerHour> tryMake(const int value) {
+		return invalid(value) != null ?
+			Result<MilesPerHour>::errorNew(invalid(value)) :
+			Result<MilesPerHour>(MilesPerHour(value));
+	}
+
+private:
+
+	/** Reason the given value is out of range, or null if it is valid. */
+	static constexpr const char* invalid(const int value) {
+		return value < 0 ? "MilesPerHour cannot be negative" : null;
+	}
+
+	static constexpr int checked(const int value) {
+		return invalid(value) != null ?
+			throw fwk::RangeException(string(invalid(value)) + " ('" + std::to_string(value) + "')") :
+			value;
+	}
 };
 
 //===============================================================
@@ -130,25 +151,40 @@ class Capacity {};
 class PassengerCount : public Ordinal<Capacity, int> {
 public:
 
-	PassengerCount(const int value = 0) :
-		Ordinal(value)
+	constexpr PassengerCount(const int value = 0) :
+		Ordinal(checked(value))
 	{
-		if (value < 0) {
-			throw fwk::RangeException("PassengerCount cannot be negative ('" + std::to_string(value) + "')");
-		}
+		// Nothing else to do
 	}
 
-	PassengerCount(const Ordinal<Capacity, int>& c) :
-		PassengerCount(c.value()) 
+	constexpr PassengerCount(const Ordinal<Capacity, int>& c) :
+		PassengerCount(c.value())
 	{
 		// Nothing else to do
 	}
 
-	PassengerCount(const PassengerCount& c):
-		PassengerCount(c.value_)
-	{
-		// Nothing else to do
-	}	
+	/**
+	 * Return a PassengerCount for the given value, or an error instead
+	 * of throwing if the value is out of range.
+	 */
+	static constexpr Result<PassengerCount> tryMake(const int value) {
+		return invalid(value) != null ?
+			Result<PassengerCount>::errorNew(invalid(value)) :
+			Result<PassengerCount>(PassengerCount(value));
+	}
+
+private:
+
+	/** Reason the given value is out of range, or null if it is valid. */
+	static constexpr const char* invalid(const int value) {
+		return value < 0 ? "PassengerCount cannot be negative" : null;
+	}
+
+	static constexpr int checked(const int value) {
+		return invalid(value) != null ?
+			throw fwk::RangeException(string(invalid(value)) + " ('" + std::to_string(value) + "')") :
+			value;
+	}
 };
 
 //===============================================================
@@ -159,25 +195,56 @@ class Segment;
 class SegmentId : public Ordinal<Segment, int> {
 public:
 
-	SegmentId(const int value = 0) :
-		Ordinal(value)
+	constexpr SegmentId(const int value = 0) :
+		Ordinal(checked(value))
 	{
-		if (value < 0) {
-			throw fwk::RangeException("SegmentId cannot be negative ('" + std::to_string(value) + "')");
-		}
+		// Nothing else to do
 	}
 
-	SegmentId(const Ordinal<Segment, int>& c) :
-		SegmentId(c.value()) 
+	constexpr SegmentId(const Ordinal<Segment, int>& c) :
+		SegmentId(c.value())
 	{
 		// Nothing else to do
 	}
 
-	SegmentId(const SegmentId& id):
-		SegmentId(id.value_)
-	{
-		// Nothing else to do
-	}	
+	/**
+	 * Return a SegmentId for the given value, or an error instead
+	 * of throwing if the value is out of range.
+	 */
+	static constexpr Result<SegmentId> tryMake(const int value) {
+		return invalid(value) != null ?
+			Result<SegmentId>::errorNew(invalid(value)) :
+			Result<SegmentId>(SegmentId(value));
+	}
+
+private:
+
+	/** Reason the given value is out of range, or null if it is valid. */
+	static constexpr const char* invalid(const int value) {
+		return value < 0 ? "SegmentId cannot be negative" : null;
+	}
+
+	static constexpr int checked(const int value) {
+		return invalid(value) != null ?
+			throw fwk::RangeException(string(invalid(value)) + " ('" + std::to_string(value) + "')") :
+			value;
+	}
 };
 
-#endif
\ No newline at end of file
+//===============================================================
+// Value types carry no vtable and copy as plain memory.
+//===============================================================
+
+static_assert(sizeof(Miles) == sizeof(double), "Miles must be a bare double");
+static_assert(sizeof(DollarsPerMile) == sizeof(double), "DollarsPerMile must be a bare double");
+static_assert(sizeof(MilesPerHour) == sizeof(int), "MilesPerHour must be a bare int");
+static_assert(sizeof(PassengerCount) == sizeof(int), "PassengerCount must be a bare int");
+static_assert(sizeof(SegmentId) == sizeof(int), "SegmentId must be a bare int");
+
+static_assert(std::is_trivially_copyable<Miles>::value, "Miles must be trivially copyable");
+static_assert(std::is_trivially_copyable<DollarsPerMile>::value, "DollarsPerMile must be trivially copyable");
+static_assert(std::is_trivially_copyable<MilesPerHour>::value, "MilesPerHour must be trivially copyable");
+static_assert(std::is_trivially_copyable<PassengerCount>::value, "PassengerCount must be trivially copyable");
+static_assert(std::is_trivially_copyable<SegmentId>::value, "SegmentId must be trivially copyable");
+
+#endif
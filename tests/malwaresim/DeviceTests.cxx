@@ -2,7 +2,30 @@
 #include "fwk/fwk.h"
 #include "MalwareStrength.h"
 #include "Port.h"
+#include "FlatVector.h"
+#include "PagedVector.h"
+#include "RingBuffer.h"
+#include "RatingKernel.h"
+#include "PortTable.h"
+#include "ComponentIndex.h"
 #include "Device.h"
+#include "InfectionEngine.h"
+#include "Network.h"
+#include "InfectionTrials.h"
+#include "NetworkScenario.h"
+#include "NetworkTracker.h"
+#include "NetworkJournal.h"
+#include "InfectionSpread.h"
+#include "ShardedNetwork.h"
+#include "MalwareScript.h"
+#include "MalwareSim.h"
+#include "ScenarioGenerator.h"
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <sstream>
+#include <thread>
 
 TEST(Device, defaultHealth) {
     const auto device = PersonalDevice::instanceNew("device-1");
@@ -14,3 +37,1191 @@ TEST(Device, healthIs) {
     device->healthIs("infected");
     ASSERT_TRUE(device->health() == "infected");
 }
+
+TEST(Device, healthState) {
+    const auto network = Network::instanceNew("network-1");
+    const Ptr<Device> a = PersonalDevice::instanceNew("a");
+    const Ptr<Device> b = PersonalDevice::instanceNew("b");
+    b->healthIs(Device::infected);
+
+    network->deviceIs(a);
+    network->deviceIs(b);
+    ASSERT_EQ(network->infectedCount(), 1u);
+
+    a->healthIs("infected");
+    ASSERT_TRUE(a->healthState() == Device::infected);
+    ASSERT_EQ(network->infectedCount(), 2u);
+    ASSERT_THROW(a->healthIs("sneezy"), std::invalid_argument);
+
+    network->deviceDel("b");
+    ASSERT_EQ(network->infectedCount(), 1u);
+    ASSERT_TRUE(network->portTable().infected(a->id()));
+}
+
+class HealthReactor : public Device::Notifiee {
+public:
+
+    static Ptr<HealthReactor> instanceNew(const Ptr<Device>& device) {
+        const Ptr<HealthReactor> reactor = new HealthReactor();
+        reactor->notifierIs(device);
+        return reactor;
+    }
+
+    void onHealth() {
+        ++healthCount;
+    }
+
+    U32 healthCount = 0;
+
+};
+
+TEST(Device, tracedHealthIs) {
+    fwk::Tracer::kindNameIs(&Device::Notifiee::onHealth, "Device::onHealth");
+
+    const auto device = PersonalDevice::instanceNew("device-1");
+    const auto reactor = HealthReactor::instanceNew(device);
+
+    fwk::Tracer::enabledIs(true);
+    device->healthIs("infected");
+    fwk::Tracer::enabledIs(false);
+
+    ASSERT_TRUE(reactor->healthCount == 1);
+    ASSERT_TRUE(fwk::Tracer::spanCount() == 1);
+
+    std::stringstream trace;
+    fwk::Tracer::flush(trace);
+    ASSERT_TRUE(trace.str().find("\"name\":\"device-1\"") != string::npos);
+    ASSERT_TRUE(trace.str().find("\"cat\":\"Device::onHealth\"") != string::npos);
+    ASSERT_TRUE(fwk::Tracer::spanCount() == 0);
+}
+
+TEST(Device, clonesShareRatings) {
+    const auto a = PersonalDevice::instanceNew("a");
+    a->portRatingIs(2, 0.5);
+    const auto b = a->cloneNew("b");
+    const auto c = b->cloneNew("c");
+    ASSERT_EQ(b->portRatings(), a->portRatings());
+    ASSERT_EQ(c->portRatings(), a->portRatings());
+    ASSERT_TRUE(c->portRating(2) == 0.5);
+    ASSERT_EQ(c->portCount(), a->portCount());
+
+    U32 p = 0;
+    for (const auto port : c->ports()) {
+        ASSERT_TRUE(port.rating() == a->portRating(p));
+        ASSERT_TRUE(port.otherDevice() == null);
+        ++p;
+    }
+    ASSERT_EQ(p, c->portCount());
+
+    // Setting an unchanged rating keeps the shared table.
+    b->portRatingIs(2, 0.5);
+    ASSERT_EQ(b->portRatings(), a->portRatings());
+
+    b->portRatingIs(2, 1.0);
+    ASSERT_NE(b->portRatings(), a->portRatings());
+    ASSERT_TRUE(b->portRating(2) == 1.0);
+    ASSERT_TRUE(a->portRating(2) == 0.5);
+    ASSERT_TRUE(c->port(2).rating() == 0.5);
+
+    // A table no longer shared is changed in place.
+    const auto ratings = b->portRatings().ptr();
+    b->portRatingIs(3, 0.25);
+    ASSERT_EQ(b->portRatings().ptr(), ratings);
+    ASSERT_TRUE(b->portRating(3) == 0.25);
+    ASSERT_TRUE(c->portRating(3) == 0.0);
+}
+
+TEST(PortTable, mirrorsConnections) {
+    const auto network = Network::instanceNew("network-1");
+    const Ptr<Device> a = PersonalDevice::instanceNew("a");
+    const Ptr<Device> b = FirewallDevice::instanceNew("b");
+    const Ptr<Device> c = PersonalDevice::instanceNew("c");
+
+    a->connectionIs(0, b, 3);
+    network->deviceIs(a);
+    network->deviceIs(b);
+    network->deviceIs(c);
+
+    const auto& table = network->portTable();
+    ASSERT_EQ(table.portCount(b->id()), 16u);
+    ASSERT_EQ(table.peer(table.row(a->id(), 0)), b->id());
+    ASSERT_EQ(table.peerPort(table.row(b->id(), 3)), 0u);
+    ASSERT_EQ(table.rating(table.row(b->id(), 3)), 1.0);
+
+    c->connectionIs(1, b, 3);
+    c->portRatingIs(1, 0.5);
+    ASSERT_EQ(table.peer(table.row(a->id(), 0)), PortTable::none);
+    ASSERT_EQ(table.peer(table.row(b->id(), 3)), c->id());
+    ASSERT_EQ(table.rating(table.row(c->id(), 1)), 0.5);
+    ASSERT_EQ(table.peerRating(table.row(b->id(), 3)), 0.5);
+    ASSERT_EQ(table.peerRating(table.row(c->id(), 1)), 1.0);
+    ASSERT_TRUE(std::isinf(table.peerRating(table.row(a->id(), 0))));
+
+    const auto id = c->id();
+    network->deviceDel("c");
+    ASSERT_EQ(table.device(id), null);
+    ASSERT_EQ(table.peer(table.row(b->id(), 3)), PortTable::none);
+    ASSERT_TRUE(std::isinf(table.peerRating(table.row(b->id(), 3))));
+    ASSERT_EQ(c->id(), PortTable::none);
+
+    c->availablePortIsTrue(1);
+}
+
+class DeviceNewReactor : public Network::Notifiee {
+public:
+
+    static Ptr<DeviceNewReactor> instanceNew(const Ptr<Network>& network) {
+        const Ptr<DeviceNewReactor> reactor = new DeviceNewReactor();
+        reactor->notifierIs(network);
+        return reactor;
+    }
+
+    void onDevicesNew(const Network::DeviceVector& devices) {
+        ++batchCount;
+        deviceCount += U32(devices.size());
+    }
+
+    U32 batchCount = 0;
+    U32 deviceCount = 0;
+
+};
+
+TEST(Network, cloneAllNew) {
+    const auto network = Network::instanceNew("network-1");
+    const Ptr<Device> a = PersonalDevice::instanceNew("a");
+    network->deviceIs(a);
+    network->deviceIs(FirewallDevice::instanceNew("a-clone"));
+    a->portRatingIs(2, 0.75);
+
+    const auto reactor = DeviceNewReactor::instanceNew(network);
+    network->cloneAllNew(3, 2);
+    network->cloneAllNew(3, 2);
+
+    ASSERT_EQ(reactor->batchCount, 2u);
+    ASSERT_EQ(reactor->deviceCount, 6u);
+    ASSERT_EQ(network->deviceCount(), 8u);
+
+    const auto c = network->device("a-clone-2");
+    ASSERT_TRUE(c != null);
+    ASSERT_TRUE(network->device("a-clone-clone") != null);
+    ASSERT_TRUE(network->device("a-clone-3") != null);
+    ASSERT_TRUE(network->device("a-clone-2-clone") != null);
+    ASSERT_TRUE(c->portRating(2) == 0.75);
+    ASSERT_TRUE(c->otherDevice(3) != null);
+
+    const auto& table = network->portTable();
+    ASSERT_EQ(table.rating(table.row(c->id(), 2)), 0.75);
+
+    ASSERT_THROW(network->cloneAllNew(8, 0), fwk::RangeException);
+
+    for (auto i = network->deviceIter(); i != network->deviceIterEnd(); ++i) {
+        for (U32 p = 0; p < i->second->portCount(); ++p) {
+            i->second->availablePortIsTrue(p);
+        }
+    }
+}
+
+class PortReactor : public Device::Notifiee {
+public:
+
+    static Ptr<PortReactor> instanceNew(const Ptr<Device>& device) {
+        const Ptr<PortReactor> reactor = new PortReactor();
+        reactor->notifierIs(device);
+        return reactor;
+    }
+
+    void onPort(const U32 p) {
+        ++portCount;
+    }
+
+    U32 portCount = 0;
+
+};
+
+TEST(Network, infectedDel) {
+    const auto network = Network::instanceNew("network-1");
+    std::vector< Ptr<Device> > d;
+    for (U32 i = 0; i < 5; ++i) {
+        d.push_back(PersonalDevice::instanceNew("d" + std::to_string(i)));
+        network->deviceIs(d[i]);
+    }
+
+    d[0]->connectionIs(0, d[1], 0);
+    d[1]->connectionIs(1, d[2], 0);
+    d[2]->connectionIs(1, d[3], 0);
+    d[3]->connectionIs(1, d[4], 0);
+    d[1]->healthIs(Device::infected);
+    d[2]->healthIs(Device::infected);
+    network->deviceDel("d4");
+
+    const auto reactor = PortReactor::instanceNew(d[3]);
+    const auto removed = network->infectedDel();
+
+    ASSERT_EQ(removed.size(), 2u);
+    ASSERT_EQ(network->deviceCount(), 2u);
+    ASSERT_EQ(network->infectedCount(), 0u);
+    ASSERT_TRUE(d[0]->availablePort(0));
+    ASSERT_TRUE(d[3]->availablePort(0));
+    ASSERT_EQ(reactor->portCount, 1u);
+    ASSERT_TRUE(d[1]->network() == null);
+    ASSERT_TRUE(d[1]->availablePort(1));
+
+    const auto& table = network->portTable();
+    ASSERT_EQ(table.deviceCount(), 2u);
+    ASSERT_EQ(d[0]->id(), 0u);
+    ASSERT_EQ(d[3]->id(), 1u);
+    ASSERT_TRUE(table.device(1) == d[3].ptr());
+    ASSERT_EQ(table.peer(table.row(1, 0)), PortTable::none);
+
+    network->devicesDel([](Device* const device) {
+        return device->name() == "d3";
+    });
+    ASSERT_TRUE(network->device("d3") == null);
+    ASSERT_TRUE(network->device("d0") != null);
+}
+
+TEST(Network, deviceHandles) {
+    const auto network = Network::instanceNew("network-1");
+    const auto a = PersonalDevice::instanceNew("a");
+    const auto b = PersonalDevice::instanceNew("b");
+    network->deviceIs(a);
+    network->deviceIs(b);
+
+    const string text = "a b";
+    ASSERT_TRUE(network->device(std::string_view(text).substr(2)) == b);
+    ASSERT_TRUE(network->device(b->id()) == b);
+    ASSERT_TRUE(network->device(U32(2)) == null);
+
+    a->healthIs(Device::infected);
+    network->infectedDel();
+    ASSERT_TRUE(network->device(b->id()) == b);
+    ASSERT_TRUE(network->device("a") == null);
+}
+
+class DestroyedReactor : public Network::Notifiee {
+public:
+
+    static Ptr<DestroyedReactor> instanceNew(const Ptr<Network>& network) {
+        const Ptr<DestroyedReactor> reactor = new DestroyedReactor();
+        reactor->notifierIs(network);
+        return reactor;
+    }
+
+    void onDeviceDel(const Ptr<Device>& device) {
+        ++deviceDelCount;
+    }
+
+    void onNetworkDestroyed() {
+        ++destroyedCount;
+    }
+
+    U32 deviceDelCount = 0;
+    U32 destroyedCount = 0;
+
+};
+
+TEST(Network, destroyedIsTrue) {
+    const auto network = Network::instanceNew("network-1");
+    const Ptr<Device> a = PersonalDevice::instanceNew("a");
+    const Ptr<Device> b = PersonalDevice::instanceNew("b");
+    const Ptr<Device> c = PersonalDevice::instanceNew("c");
+    network->deviceIs(a);
+    network->deviceIs(b);
+    a->connectionIs(0, b, 0);
+    a->connectionIs(1, c, 0);
+
+    const auto reactor = DestroyedReactor::instanceNew(network);
+    const auto tracker = NetworkTracker::instanceNew(network);
+    const auto aPorts = PortReactor::instanceNew(a);
+    const auto cPorts = PortReactor::instanceNew(c);
+
+    network->destroyedIsTrue();
+    ASSERT_EQ(reactor->destroyedCount, 1u);
+    ASSERT_EQ(reactor->deviceDelCount, 0u);
+    ASSERT_EQ(network->deviceCount(), 0u);
+    ASSERT_EQ(network->portTable().deviceCount(), 0u);
+    ASSERT_EQ(tracker->deviceCount(), 0u);
+
+    // Only the connection leaving the network is cleared with notifications.
+    ASSERT_EQ(aPorts->portCount, 1u);
+    ASSERT_EQ(cPorts->portCount, 1u);
+    ASSERT_TRUE(a->availablePort(0) && b->availablePort(0));
+    ASSERT_TRUE(c->availablePort(0));
+    ASSERT_TRUE(a->network() == null);
+    ASSERT_EQ(a->id(), PortTable::none);
+
+    network->deviceIs(a);
+    ASSERT_EQ(tracker->deviceCount(), 1u);
+    ASSERT_EQ(a->id(), 0u);
+}
+
+TEST(Network, components) {
+    const auto network = Network::instanceNew("network-1");
+    std::vector< Ptr<Device> > d;
+    for (U32 i = 0; i < 6; ++i) {
+        d.push_back(PersonalDevice::instanceNew("d" + std::to_string(i)));
+        network->deviceIs(d[i]);
+    }
+
+    d[0]->connectionIs(0, d[1], 0);
+    d[1]->connectionIs(1, d[2], 0);
+    d[3]->connectionIs(0, d[4], 0);
+    d[2]->portRatingIs(0, 0.8);
+    ASSERT_TRUE(network->connected(d[0], d[2]));
+    ASSERT_FALSE(network->connected(d[0], d[3]));
+    ASSERT_EQ(network->componentSize(d[1]), 3u);
+    ASSERT_EQ(network->componentSize(d[5]), 1u);
+
+    // The hardened port cuts d2 off from weaker malware.
+    ASSERT_FALSE(network->connected(d[0], d[2], 0.5));
+    ASSERT_EQ(network->componentSize(d[0], 0.5), 2u);
+    ASSERT_TRUE(network->connected(d[0], d[2], 0.9));
+
+    d[1]->availablePortIsTrue(1);
+    ASSERT_FALSE(network->connected(d[0], d[2]));
+    d[2]->connectionIs(1, d[3], 1);
+    ASSERT_EQ(network->componentSize(d[4]), 3u);
+
+    network->deviceDel("d3");
+    ASSERT_EQ(network->componentSize(d[4]), 1u);
+    ASSERT_FALSE(network->connected(d[2], d[3]));
+
+    for (const auto& x : d) {
+        x->availablePortIsTrue(0);
+        x->availablePortIsTrue(1);
+    }
+}
+
+/** Sequential breadth-first flood order, leaving health unchanged. */
+static std::vector<Device*> floodOrder(
+    const Ptr<Network>& network, const MalwareStrength strength,
+    const Ptr<Device>& start
+) {
+    std::vector<Device*> order(1, start.ptr());
+    std::unordered_map<Device*, bool> seen;
+    seen[start.ptr()] = true;
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        const auto d = order[i];
+        for (U32 p = 0; p < d->portCount(); ++p) {
+            const auto& other = d->otherDevice(p);
+            if (other != null && !seen[other.ptr()] &&
+                other->healthState() != Device::infected &&
+                !other->port(d->otherPort(p)).blocks(strength)
+            ) {
+                seen[other.ptr()] = true;
+                order.push_back(other.ptr());
+            }
+        }
+    }
+
+    return order;
+}
+
+TEST(RatingKernel, matchesPortBlocks) {
+    const MalwareStrength strength = 0.5;
+    const auto tol = MalwareStrength::tol;
+    const double edges[] = {
+        0.0, 0.5 - 2 * tol, 0.5 - tol, std::nextafter(0.5 - tol, 1.0),
+        0.5 - tol / 2, 0.5, 0.5 + tol / 2, 0.5 + tol, 1.0
+    };
+
+    std::vector<double> ratings;
+    for (U32 i = 0; i < 203; ++i) {
+        ratings.push_back(edges[(i * 7) % 9]);
+    }
+
+    const auto threshold = RatingKernel::openThreshold(strength);
+    for (U32 set = RatingKernel::scalar; set <= RatingKernel::best(); ++set) {
+        std::vector<U64> mask(4, ~U64(0));
+        RatingKernel::openMaskIs(
+            ratings.data(), ratings.size(), threshold, mask.data(),
+            RatingKernel::InstructionSet(set)
+        );
+
+        for (U32 i = 0; i < 256; ++i) {
+            Port port;
+            port.ratingIs(i < ratings.size() ? ratings[i] : 0.0);
+            const bool open = i < ratings.size() && !port.blocks(strength);
+            ASSERT_EQ(((mask[i / 64] >> (i % 64)) & 1) != 0, open) << set << ' ' << i;
+        }
+    }
+
+    const auto d = FirewallDevice::instanceNew("d");
+    d->portRatingIs(1, 0.5 - 2 * tol);
+    d->portRatingIs(2, 0.5 - tol / 2);
+    d->portRatingIs(3, 0.2);
+    ASSERT_EQ(d->openPorts(strength), 0x0au);
+    ASSERT_EQ(d->openPorts(strength, 2), 0x02u);
+    ASSERT_EQ(d->openPorts(strength, 16), 0u);
+}
+
+TEST(InfectionEngine, matchesSequentialOrder) {
+    const auto network = Network::instanceNew("network-1");
+
+    std::vector< Ptr<Device> > devices;
+    for (U32 i = 0; i < 20000; ++i) {
+        const Ptr<Device> d = FirewallDevice::instanceNew("d" + std::to_string(i));
+        network->deviceIs(d);
+        devices.push_back(d);
+    }
+
+    U64 seed = 1;
+    const auto random = [&seed](const U64 n) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        return (seed >> 33) % n;
+    };
+
+    for (const auto& d : devices) {
+        for (U32 p = 0; p < d->portCount(); ++p) {
+            d->portRatingIs(p, random(4) == 0 ? 1.0 : 0.25);
+            if (d->availablePort(p)) {
+                const auto& other = devices[random(devices.size())];
+                const auto p2 = U32(random(other->portCount()));
+                if (other != d && other->availablePort(p2)) {
+                    d->connectionIs(p, other, p2);
+                }
+            }
+        }
+    }
+
+    const auto expected = floodOrder(network, 0.5, devices[0]);
+    ASSERT_TRUE(expected.size() > 1000);
+
+    // A reused engine starts each flood with no claims left over.
+    InfectionEngine engine(4);
+    for (U32 i = 1; i <= 3; ++i) {
+        std::vector<U32> ids;
+        for (const auto d : floodOrder(network, 0.5, devices[i])) {
+            ids.push_back(d->id());
+        }
+
+        ASSERT_TRUE(engine.spreadNew(network->portTable(), 0.5, devices[i]->id()) == ids);
+    }
+
+    const auto infected = engine.infectionIs(
+        network->portTable(), 0.5, devices[0]->id()
+    );
+
+    ASSERT_TRUE(infected == expected);
+    for (const auto d : expected) {
+        ASSERT_TRUE(d->health() == "infected");
+    }
+
+    for (const auto& d : devices) {
+        for (U32 p = 0; p < d->portCount(); ++p) {
+            d->availablePortIsTrue(p);
+        }
+    }
+}
+
+TEST(InfectionTrials, reproducible) {
+    const auto network = Network::instanceNew("network-1");
+    std::vector< Ptr<Device> > d;
+    for (U32 i = 0; i < 200; ++i) {
+        d.push_back(PersonalDevice::instanceNew("d" + std::to_string(i)));
+        network->deviceIs(d[i]);
+        for (U32 p = 0; p < 8; ++p) {
+            d[i]->portRatingIs(p, (i * 8 + p) % 5 * 0.25);
+        }
+    }
+
+    for (U32 i = 1; i < d.size(); ++i) {
+        d[i]->connectionIs(i % 8, d[(i * 7) % i], (i / 8) % 8);
+    }
+
+    const auto trials = InfectionTrials::instanceNew(network);
+    trials->trialCountIs(500);
+    trials->seedIs(42);
+    trials->ratingNoiseIs(0.1);
+
+    trials->threadCountIs(1);
+    const auto one = trials->summaryNew();
+    trials->threadCountIs(4);
+    const auto four = trials->summaryNew();
+
+    ASSERT_EQ(one.trials.size(), 500u);
+    for (U32 t = 0; t < 500; ++t) {
+        ASSERT_EQ(one.trials[t].device, four.trials[t].device);
+        ASSERT_EQ(one.trials[t].infectedCount, four.trials[t].infectedCount);
+        ASSERT_EQ(one.trials[t].containTime, four.trials[t].containTime);
+    }
+
+    ASSERT_EQ(one.infectedCount.mean, four.infectedCount.mean);
+    ASSERT_TRUE(one.infectedCount.max > 1);
+    ASSERT_TRUE(one.depth.p99 >= one.depth.p50);
+    ASSERT_EQ(network->infectedCount(), 0u);
+
+    // Without noise, a trial infects what the network's infection would.
+    trials->ratingNoiseIs(0.0);
+    trials->trialCountIs(20);
+    for (const auto& t : trials->summaryNew().trials) {
+        const auto device = network->portTable().device(t.device);
+        network->infectionIs(t.strength, device, t.port);
+        ASSERT_EQ(network->infectedCount(), t.infectedCount);
+        for (const auto& x : d) {
+            x->healthIs(Device::healthy);
+        }
+    }
+
+    for (const auto& x : d) {
+        for (U32 p = 0; p < 8; ++p) {
+            x->availablePortIsTrue(p);
+        }
+    }
+}
+
+TEST(NetworkScenario, copyOnWrite) {
+    const auto network = Network::instanceNew("network-1");
+    std::vector< Ptr<Device> > d;
+    for (U32 i = 0; i < 1000; ++i) {
+        d.push_back(PersonalDevice::instanceNew("d" + std::to_string(i)));
+        network->deviceIs(d[i]);
+        if (i > 0) {
+            d[i - 1]->connectionIs(1, d[i], 0);
+        }
+    }
+    d[500]->portRatingIs(0, 1.0);
+
+    const auto scenario = NetworkScenario::instanceNew(network);
+    const auto hardened = scenario->scenarioNew();
+    ASSERT_EQ(hardened->portTable().ownPageCount(), 0u);
+
+    // The rating and the peer's copy of it, one page each.
+    hardened->portRatingIs(d[100]->id(), 0, 1.0);
+    ASSERT_EQ(hardened->portTable().ownPageCount(), 2u);
+    ASSERT_TRUE(scenario->portRating(d[100]->id(), 0) == 0.0);
+
+    ASSERT_EQ(scenario->infectionIs(0.5, d[0]->id(), 2).size(), 500u);
+    ASSERT_EQ(hardened->infectionIs(0.5, d[0]->id(), 2).size(), 100u);
+    ASSERT_EQ(hardened->infectionIs(0.5, d[0]->id(), 2).size(), 0u);
+    ASSERT_EQ(network->infectedCount(), 0u);
+
+    // Changing the network after branching leaves the branches alone.
+    d[0]->portRatingIs(2, 1.0);
+    ASSERT_TRUE(scenario->portRating(d[0]->id(), 2) == 0.0);
+    network->deviceDel("d999");
+    ASSERT_EQ(scenario->portTable().peer(scenario->portTable().row(998, 1)), 999u);
+
+    for (const auto& x : d) {
+        x->availablePortIsTrue(0);
+        x->availablePortIsTrue(1);
+    }
+}
+
+TEST(NetworkTracker, counts) {
+    const auto network = Network::instanceNew("network-1");
+    const auto p = PersonalDevice::instanceNew("p");
+    const auto m = MobileDevice::instanceNew("m");
+    const auto f = FirewallDevice::instanceNew("f");
+    network->deviceIs(p);
+    network->deviceIs(m);
+    p->connectionIs(0, m, 0);
+
+    const auto tracker = NetworkTracker::instanceNew(network);
+    ASSERT_EQ(tracker->deviceCount(), 2u);
+    ASSERT_EQ(tracker->connectionCount(), 2u);
+    ASSERT_EQ(tracker->freePortCount(), 14u);
+
+    network->deviceIs(f);
+    f->connectionIs(0, p, 1);
+    m->healthIs(Device::infected);
+    p->healthIs(Device::infected);
+    ASSERT_EQ(tracker->personalCount(), 1u);
+    ASSERT_EQ(tracker->mobileCount(), 1u);
+    ASSERT_EQ(tracker->firewallCount(), 1u);
+    ASSERT_EQ(tracker->infectedCount(), 2u);
+    ASSERT_EQ(tracker->connectionCount(), 4u);
+    ASSERT_EQ(tracker->freePortCount(), 28u);
+
+    network->cloneAllNew(2, 2);
+    ASSERT_EQ(tracker->deviceCount(), 6u);
+    ASSERT_EQ(tracker->connectionCount(), 10u);
+
+    // Bulk removal clears ports without onPort on the removed devices.
+    network->infectedDel();
+    ASSERT_EQ(tracker->deviceCount(), network->deviceCount());
+    ASSERT_EQ(tracker->infectedCount(), 0u);
+    ASSERT_EQ(tracker->personalCount(), 1u);
+    ASSERT_EQ(tracker->mobileCount(), 1u);
+
+    U32 connected = 0;
+    U32 ports = 0;
+    for (auto i = network->deviceIter(); i != network->deviceIterEnd(); ++i) {
+        for (U32 q = 0; q < i->second->portCount(); ++q) {
+            connected += !i->second->availablePort(q);
+            ++ports;
+        }
+    }
+    ASSERT_EQ(tracker->connectionCount(), connected);
+    ASSERT_EQ(tracker->freePortCount(), ports - connected);
+}
+
+/** Devices of a network with their health, ratings and connections. */
+static string networkState(const Ptr<Network>& network) {
+    std::map<string, string> devices;
+    for (auto i = network->deviceIter(); i != network->deviceIterEnd(); ++i) {
+        const auto& d = i->second;
+        std::stringstream state;
+        state << d->health();
+        for (U32 p = 0; p < d->portCount(); ++p) {
+            state << ' ' << d->portRating(p).value();
+            if (d->otherDevice(p) != null) {
+                state << '>' << d->otherDevice(p)->name() << ':' << d->otherPort(p);
+            }
+        }
+        devices[d->name()] = state.str();
+    }
+
+    string state;
+    for (const auto& d : devices) {
+        state += d.first + ' ' + d.second + '\n';
+    }
+
+    return state;
+}
+
+TEST(NetworkJournal, replay) {
+    const auto network = Network::instanceNew("network-1");
+    network->deviceIs(PersonalDevice::instanceNew("a"));
+    const auto journal = NetworkJournal::instanceNew(network, 16);
+    const auto spill = testing::TempDir() + "journal.bin";
+    ASSERT_TRUE(journal->spillFileIs(spill));
+
+    std::vector< std::pair<U64, string> > states;
+    const auto stateIs = [&]() {
+        states.emplace_back(journal->eventCount(), networkState(network));
+    };
+
+    network->deviceIs(FirewallDevice::instanceNew("f"));
+    network->deviceIs(MobileDevice::instanceNew("m"));
+    network->device("a")->connectionIs(0, network->device("f"), 1);
+    network->device("a")->portRatingIs(1, 0.5);
+    stateIs();
+
+    network->cloneAllNew(2, 3);
+    network->device("m")->connectionIs(4, network->device("a"), 0);
+    stateIs();
+
+    network->infectionIs(0.75, network->device("a"), 5);
+    stateIs();
+
+    network->infectedDel();
+    network->device("f-clone")->portRatingIs(0, 0.25);
+    stateIs();
+
+    network->devicesDel([](Device* const device) {
+        return device->name() == "f-clone";
+    });
+    network->deviceIs(PersonalDevice::instanceNew("a"));
+    network->device("f")->connectionIs(0, network->device("a"), 7);
+    stateIs();
+
+    ASSERT_GT(journal->eventCount(), 16u);
+    ASSERT_EQ(journal->firstEvent(), 0u);
+    ASSERT_EQ(journal->event(0).type, NetworkJournal::deviceNew);
+    ASSERT_EQ(journal->deviceName(journal->event(0).device), "a");
+
+    for (const auto& s : states) {
+        ASSERT_EQ(networkState(journal->networkNew("replay", s.first)), s.second)
+            << s.first;
+    }
+
+    // Replay starts from the latest checkpoint, not from event 0.
+    ASSERT_GT(journal->checkpointCount(), 1u);
+
+    // Without a spill file, the oldest events are dropped, and only
+    // checkpoints followed by kept events can be replayed from.
+    const auto small = NetworkJournal::instanceNew(network, 4);
+    ASSERT_GT(small->eventCount(), 4u);
+    ASSERT_EQ(small->firstEvent(), small->eventCount() - 4);
+    ASSERT_THROW(small->networkNew("replay", 1), fwk::RangeException);
+    ASSERT_EQ(networkState(small->networkNew("replay", small->eventCount())),
+        networkState(network));
+
+    std::remove(spill.c_str());
+}
+
+TEST(NetworkJournal, replayAfterWrap) {
+    const auto network = Network::instanceNew("network-1");
+    for (U32 i = 0; i < 8; ++i) {
+        network->deviceIs(PersonalDevice::instanceNew("d" + std::to_string(i)));
+    }
+    const auto journal = NetworkJournal::instanceNew(network, 64);
+
+    std::vector< std::pair<U64, string> > states;
+    for (U32 k = 0; k < 200; ++k) {
+        const auto d = network->device("d" + std::to_string(k % 8));
+        if (k % 3 == 0) {
+            d->connectionIs(k % 5, network->device("d" + std::to_string((k + 3) % 8)), k % 7);
+        } else {
+            d->portRatingIs(k % 8, (k % 4) * 0.25);
+        }
+        states.emplace_back(journal->eventCount(), networkState(network));
+    }
+
+    ASSERT_GT(journal->firstEvent(), 0u);
+
+    // Every state whose events were kept since some checkpoint is rebuilt,
+    // which includes at least the last half ring.
+    U32 rebuilt = 0;
+    for (const auto& s : states) {
+        try {
+            ASSERT_EQ(networkState(journal->networkNew("replay", s.first)), s.second)
+                << s.first;
+            ++rebuilt;
+        } catch (const fwk::RangeException&) {
+            ASSERT_LT(s.first + 32, journal->eventCount()) << s.first;
+        }
+    }
+    ASSERT_GT(rebuilt, 0u);
+    ASSERT_LT(rebuilt, states.size());
+}
+
+TEST(NetworkJournal, boundedCheckpoints) {
+    const auto network = Network::instanceNew("network-1");
+    for (U32 i = 0; i < 4; ++i) {
+        network->deviceIs(PersonalDevice::instanceNew("d" + std::to_string(i)));
+    }
+    const auto journal = NetworkJournal::instanceNew(network, 16);
+    const auto spill = testing::TempDir() + "bounded.bin";
+    ASSERT_TRUE(journal->spillFileIs(spill));
+
+    std::vector< std::pair<U64, string> > states;
+    for (U32 k = 0; k < 20000; ++k) {
+        const auto d = network->device("d" + std::to_string(k % 4));
+        d->portRatingIs(k % 8, (k % 5) * 0.25);
+        if (k % 997 == 0) {
+            states.emplace_back(journal->eventCount(), networkState(network));
+        }
+        ASSERT_LE(journal->checkpointCount(), NetworkJournal::checkpointLimit);
+    }
+
+    // Nothing was dropped, so every state still replays.
+    ASSERT_EQ(journal->firstEvent(), 0u);
+    ASSERT_GT(journal->checkpointCount(), NetworkJournal::checkpointLimit / 2);
+    for (const auto& s : states) {
+        ASSERT_EQ(networkState(journal->networkNew("replay", s.first)), s.second)
+            << s.first;
+    }
+
+    std::remove(spill.c_str());
+}
+
+TEST(InfectionSpread, overTime) {
+    const auto manager = fwk::SequentialManager::instance();
+    const auto network = Network::instanceNew("network-1");
+    std::vector< Ptr<Device> > d;
+    for (U32 i = 0; i < 4; ++i) {
+        d.push_back(PersonalDevice::instanceNew("d" + std::to_string(i)));
+        network->deviceIs(d[i]);
+        if (i > 0) {
+            d[i - 1]->connectionIs(1, d[i], 0);
+        }
+    }
+    d[2]->portRatingIs(1, 0.5);
+    d[3]->portRatingIs(0, 1.0);
+
+    const auto spread = InfectionSpread::instanceNew(network, manager);
+    const auto start = manager->now();
+    spread->infectionIs(1.0, d[0], 0);
+
+    // Crossing takes hopTime times (1 + rating) for each port.
+    manager->nowIs(start + 0.5);
+    ASSERT_EQ(network->infectedCount(), 0u);
+    manager->nowIs(start + 1.0);
+    ASSERT_TRUE(d[0]->healthState() == Device::infected);
+    manager->nowIs(start + 2.0);
+    ASSERT_TRUE(d[1]->healthState() == Device::infected);
+    ASSERT_EQ(spread->hopCount(), 1u);
+    manager->nowIs(start + 3.0);
+    ASSERT_TRUE(d[2]->healthState() == Device::infected);
+    manager->nowIs(start + 10.0);
+    ASSERT_EQ(spread->infectedCount(), 3u);
+    ASSERT_EQ(spread->hopCount(), 0u);
+    ASSERT_TRUE(d[3]->healthState() == Device::healthy);
+
+    ASSERT_EQ(d[2]->port(1).transmissionProbability(0.75), 0.5);
+    ASSERT_TRUE(d[2]->port(1).transmissionDelay(2.0) == 3.0);
+
+    for (const auto& x : d) {
+        x->availablePortIsTrue(0);
+        x->availablePortIsTrue(1);
+    }
+}
+
+TEST(ShardedNetwork, matchesNetwork) {
+    const auto network = Network::instanceNew("network-1");
+    const auto sharded = ShardedNetwork::instanceNew("sharded-1", 3);
+
+    U64 state = 7;
+    const auto random = [&state](const U32 n) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return U32((state >> 33) % n);
+    };
+
+    const U32 n = 300;
+    for (U32 i = 0; i < n; ++i) {
+        const auto name = "d" + std::to_string(i);
+        if (i % 10 == 0) {
+            network->deviceIs(FirewallDevice::instanceNew(name));
+            sharded->firewallNew(name);
+        } else {
+            network->deviceIs(PersonalDevice::instanceNew(name));
+            sharded->personalNew(name);
+        }
+    }
+
+    // Random links, some replacing earlier ones, and random ratings.
+    for (U32 k = 0; k < 2 * n; ++k) {
+        const auto a = random(n);
+        const auto b = (a + 1 + random(n - 1)) % n;
+        const auto pa = random(8);
+        const auto pb = random(8);
+        const auto nameA = "d" + std::to_string(a);
+        const auto nameB = "d" + std::to_string(b);
+        network->device(nameA)->connectionIs(pa, network->device(nameB), pb);
+        sharded->connectionIs(nameA, pa, nameB, pb);
+
+        const double rating = random(4) * 0.25;
+        network->device(nameB)->portRatingIs(pb, rating);
+        sharded->portRatingIs(nameB, pb, rating);
+    }
+    ASSERT_EQ(sharded->deviceCount(), n);
+    ASSERT_GT(sharded->proxyCount(), 0u);
+
+    for (U32 k = 0; k < 6; ++k) {
+        const auto name = "d" + std::to_string(random(n));
+        const double strength = 0.5 + random(3) * 0.25;
+        const auto before = network->infectedCount();
+        network->infectionIs(strength, network->device(name), 0);
+
+        ASSERT_EQ(sharded->infectionIs(strength, name, 0),
+            network->infectedCount() - before);
+        ASSERT_EQ(sharded->infectedCount(), network->infectedCount());
+    }
+
+    network->infectedDel();
+    sharded->infectedDel();
+    ASSERT_EQ(sharded->deviceCount(), network->deviceCount());
+    ASSERT_EQ(sharded->infectedCount(), 0u);
+
+    // Removed devices take their proxies with them.
+    U32 crossLinks = 0;
+    for (auto i = network->deviceIter(); i != network->deviceIterEnd(); ++i) {
+        const auto& d = i->second;
+        for (U32 p = 0; p < d->portCount(); ++p) {
+            const auto& other = d->otherDevice(p);
+            if (other != null && sharded->shard(other->name()) != sharded->shard(d->name())) {
+                ++crossLinks;
+            }
+        }
+    }
+    ASSERT_EQ(sharded->proxyCount(), crossLinks);
+
+    const auto name = network->deviceIter()->second->name();
+    network->infectionIs(1.0, network->device(name), 7);
+    ASSERT_EQ(sharded->infectionIs(1.0, name, 7), network->infectedCount());
+    ASSERT_EQ(sharded->errorCount(), 0u);
+}
+
+static string evalScript(
+    const string& script, string* const errors = null, const U32 shardCount = 0
+) {
+    std::stringstream output;
+    std::stringstream errorOutput;
+    const auto sim = MalwareSim::instanceNew(output, errorOutput);
+    sim->shardCountIs(shardCount);
+    sim->evalBuffer(script.data(), script.size());
+
+    if (errors != null) {
+        *errors = errorOutput.str();
+    }
+
+    return output.str();
+}
+
+TEST(MalwareSim, script1) {
+    const string script =
+        "# Comment.\n"
+        "Network networkNew network-1\n"
+        "Network network-1 personalNew personal-1\n"
+        "Device network-1 personal-1 0 ratingIs 1.0\n"
+        "Device network-1 personal-1 1 ratingIs 1.0\n"
+        "Network network-1 firewallNew firewall-1\n"
+        "Device network-1 personal-1 0 connectionIs firewall-1 1\n"
+        "Device network-1 firewall-1 0 clone firewall-2 1\n"
+        "Device network-1 personal-1 1 clone personal-2 0\n"
+        "\n"
+        "Network network-1 cloneAll 3 2\n"
+        "Network network-1 infectionIs 1.0 personal-1 2\n"
+        "Network network-1 infectedDel\n"
+        "Network network-1 infectionIs 1.0 personal-2 2\n";
+
+    string errors;
+    ASSERT_EQ(evalScript(script, &errors), "2 6 2 4 4 2\n2 4 2 2 4 0\n");
+    ASSERT_EQ(errors, "");
+}
+
+TEST(MalwareSim, route) {
+    const string script =
+        "Network networkNew n\n"
+        "Network n personalNew a\n"
+        "Device n a 0 ratingIs 1.0\n"
+        "Device n a 0 clone b 1\n"
+        "Device n b 0 clone c 1\n"
+        "Network n infectionIs 0.5 a 0 0 2\n"
+        "Network n infectionIs 0.5 a 0 0 0 2\n";
+
+    string errors;
+    ASSERT_EQ(evalScript(script, &errors), "1 2 1 3 0 1\n");
+    ASSERT_EQ(errors, "line 7: route reaches unconnected port '0'\n");
+}
+
+TEST(MalwareSim, errors) {
+    const string script =
+        "Network networkNew n\n"
+        "Network networkNew n\n"
+        "Network m personalNew a\n"
+        "Network n personalNew a\n"
+        "Device n a 8 ratingIs 1.0\n"
+        "Device n a 0 ratingIs 1.5\n"
+        "Device n a 0 ratingIs x\n"
+        "Device n a 0 explode\n"
+        "Frobnicate\n";
+
+    string errors;
+    ASSERT_EQ(evalScript(script, &errors), "");
+    ASSERT_EQ(errors,
+        "line 2: network already exists 'n'\n"
+        "line 3: unknown network 'm'\n"
+        "line 5: port out of range '8'\n"
+        "line 6: rating out of range 0..1 '1.5'\n"
+        "line 7: invalid number 'x'\n"
+        "line 8: incomplete command 'Device'\n"
+        "line 9: unknown command 'Frobnicate'\n"
+    );
+}
+
+TEST(MalwareSim, compiledScript) {
+    const string script =
+        "Network networkNew n\n"
+        "Network n personalNew a\n"
+        "Device n a 0 ratingIs $r\n"
+        "Device n a 0 clone b 1\n"
+        "Device n a 9 clone c 1\n"
+        "Device n a 1 explode x\n"
+        "Network n infectionIs $s a $p\n";
+
+    const auto compiled = MalwareScript::instanceNew(script.data(), script.size());
+    ASSERT_EQ(compiled->nameCount(), 4u);
+    ASSERT_EQ(compiled->parameterCount(), 3u);
+
+    // One compiled script runs over a sweep of parameter values.
+    for (const auto s : { 0.25, 1.0 }) {
+        std::stringstream output;
+        std::stringstream errors;
+        const auto sim = MalwareSim::instanceNew(output, errors);
+        sim->parameterIs("r", 0.5);
+        sim->parameterIs("s", s);
+        sim->parameterIs("p", 0);
+        sim->eval(compiled);
+
+        ASSERT_EQ(output.str(), s < 0.5 ? "0 2 0 2 0 0\n" : "2 0 2 2 0 0\n");
+        ASSERT_EQ(errors.str(),
+            "line 5: port out of range '9'\n"
+            "line 6: unknown device command 'explode'\n"
+        );
+    }
+
+    std::stringstream output;
+    std::stringstream errors;
+    const auto sim = MalwareSim::instanceNew(output, errors);
+    sim->parameterIs("r", 0.5);
+    sim->parameterIs("s", 1.0);
+    sim->eval(compiled);
+    ASSERT_EQ(errors.str().substr(errors.str().rfind("line 7")),
+        "line 7: unbound parameter '$p'\n"
+    );
+
+    // A cached script is read back instead of compiled.
+    const auto path = testing::TempDir() + "malwaresim-test.txt";
+    std::ofstream(path) << script;
+    sim->cacheDirectoryIs(testing::TempDir());
+    ASSERT_TRUE(sim->scriptFileNew(path) != null);
+
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx.msc",
+        (unsigned long long) MalwareScript::textHash(script.data(), script.size())
+    );
+    const auto cached = testing::TempDir() + name;
+    ASSERT_TRUE(std::ifstream(cached).good());
+
+    const auto read = sim->scriptFileNew(path);
+    ASSERT_EQ(read->instructions().size(), compiled->instructions().size());
+    ASSERT_EQ(read->name(3), "c");
+    ASSERT_EQ(read->parameterName(2), "p");
+    std::remove(path.c_str());
+    std::remove(cached.c_str());
+}
+
+TEST(MalwareSim, pipelinedStream) {
+    // Enough lines for several blocks, with names and errors on both
+    // sides of block boundaries.
+    string script = "Network networkNew n\nNetwork n personalNew a\n";
+    for (U32 i = 0; i < 5000; ++i) {
+        const auto d = "d" + std::to_string(i % 700);
+        script += i < 700 ? "Network n personalNew " + d + "\n" : "";
+        script += "Device n " + d + " 0 ratingIs 0." + std::to_string(i % 10) + "\n";
+        script += i % 997 == 0 ? "Device n x 0 ratingIs 0.5\n" : "";
+        script += i % 1500 == 0 ? "Network n infectionIs 0.5 " + d + " 0\n" : "";
+    }
+    script += "Device n a 9 ratingIs 0.5";
+
+    string errors;
+    const auto output = evalScript(script, &errors);
+
+    std::stringstream streamOutput;
+    std::stringstream streamErrors;
+    std::stringstream input(script);
+    const auto sim = MalwareSim::instanceNew(streamOutput, streamErrors);
+    sim->evalStream(input);
+
+    ASSERT_EQ(streamOutput.str(), output);
+    ASSERT_EQ(streamErrors.str(), errors);
+    ASSERT_EQ(std::count(errors.begin(), errors.end(), '\n'), 7);
+}
+
+/** Input that arrives all at once after a delay, like a slow pipe. */
+class DelayedStreamBuf : public std::streambuf {
+public:
+
+    DelayedStreamBuf(const string& text, const double delay) :
+        text_(text),
+        delay_(delay),
+        arrived_(false)
+    {
+        // Nothing else to do.
+    }
+
+protected:
+
+    int_type underflow() override {
+        if (arrived_ || text_.empty()) {
+            return traits_type::eof();
+        }
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(delay_));
+        arrived_ = true;
+        setg(&text_[0], &text_[0], &text_[0] + text_.size());
+        return traits_type::to_int_type(text_[0]);
+    }
+
+private:
+
+    string text_;
+    double delay_;
+    bool arrived_;
+
+};
+
+TEST(MalwareSim, idleStream) {
+    // While the reader waits for input, the executor sleeps instead
+    // of spinning, so a second of waiting costs next to no CPU.
+    DelayedStreamBuf buffer("Network networkNew n\nNetwork n personalNew a\n", 1.0);
+    std::istream input(&buffer);
+
+    std::stringstream output;
+    std::stringstream errors;
+    const auto sim = MalwareSim::instanceNew(output, errors);
+
+    const auto begin = std::clock();
+    sim->evalStream(input);
+    const auto seconds = double(std::clock() - begin) / CLOCKS_PER_SEC;
+
+    ASSERT_LT(seconds, 0.2);
+    ASSERT_EQ(errors.str(), "");
+}
+
+TEST(MalwareSim, shardedNetworks) {
+    // Generated scenarios print the same stats on 3 shards.
+    const auto generator = ScenarioGenerator::instanceNew();
+    generator->deviceCountIs(300);
+    generator->infectionCountIs(3);
+    generator->firewallFractionIs(0.2);
+
+    for (U32 t = 0; t < ScenarioGenerator::topologyCount; ++t) {
+        generator->topologyIs(ScenarioGenerator::Topology(t));
+
+        std::stringstream script;
+        generator->scriptOut(script);
+
+        string errors;
+        const auto output = evalScript(script.str(), &errors, 3);
+        ASSERT_EQ(errors, "") << ScenarioGenerator::name(generator->topology());
+        ASSERT_EQ(output, evalScript(script.str()));
+    }
+
+    const string script =
+        "Network networkNew n\n"
+        "Network n personalNew a\n"
+        "Network n firewallNew b\n"
+        "Network n personalNew a\n"
+        "Device n a 0 connectionIs b 1\n"
+        "Device n a 8 ratingIs 1.0\n"
+        "Device n c 0 connectionIs a 1\n"
+        "Device n b 1 connectionIs a 9\n"
+        "Network n infectionIs 1.0 a 0\n"
+        "Network n infectionIs 1.0 b 1 0\n"
+        "Network n cloneAll 1 2\n"
+        "Device n a 1 clone d 0\n"
+        "Network n infectedDel\n"
+        "Network n infectionIs 1.0 a 0\n";
+
+    string errors;
+    ASSERT_EQ(evalScript(script, &errors, 2), "1 1 1 1 1 1\n");
+    ASSERT_EQ(errors,
+        "line 4: device already exists 'a'\n"
+        "line 6: port out of range '8'\n"
+        "line 7: unknown device 'c'\n"
+        "line 8: port out of range '9'\n"
+        "line 10: route not supported on a sharded network '1'\n"
+        "line 11: not supported on a sharded network 'n'\n"
+        "line 12: not supported on a sharded network 'n'\n"
+        "line 14: unknown device 'a'\n"
+    );
+}
+
+TEST(ScenarioGenerator, validScripts) {
+    const auto generator = ScenarioGenerator::instanceNew();
+    generator->deviceCountIs(500);
+    generator->infectionCountIs(2);
+    generator->firewallFractionIs(0.1);
+
+    for (U32 t = 0; t < ScenarioGenerator::topologyCount; ++t) {
+        generator->topologyIs(ScenarioGenerator::Topology(t));
+
+        std::stringstream script;
+        const auto commands = generator->scriptOut(script);
+        ASSERT_EQ(U64(std::count(
+            std::istreambuf_iterator<char>(script), std::istreambuf_iterator<char>(),
+            '\n'
+        )), commands);
+
+        // Every command is valid, and every device was created.
+        string errors;
+        std::stringstream output(evalScript(script.str(), &errors));
+        ASSERT_EQ(errors, "") << ScenarioGenerator::name(generator->topology());
+
+        for (U32 i = 0; i < generator->infectionCount(); ++i) {
+            U32 infected, healthy;
+            output >> infected >> healthy;
+            ASSERT_EQ(infected + healthy, 500u);
+            output.ignore(64, '\n');
+        }
+
+        std::stringstream again;
+        generator->scriptOut(again);
+        ASSERT_EQ(again.str(), script.str());
+    }
+}
@@ -4,6 +4,10 @@
 #include "Conn.h"
 #include "TravelInstanceManager.h"
 
+#include <fstream>
+#include <limits>
+#include <unistd.h>
+
 void initializeSegment(const Ptr<Segment> seg, 
 						   const Ptr<Location>& source, 
 						   const Ptr<Location>& destination, 
@@ -850,6 +854,26 @@ TEST(DollarsPerMile, addition) {
 	ASSERT_TRUE(m3 == DollarsPerMile(11.3));
 }
 
+TEST(Miles, tryMake) {
+	const auto valid = Miles::tryMake(4.5);
+	ASSERT_TRUE(valid.ok());
+	ASSERT_TRUE(valid.value() == Miles(4.5));
+
+	const auto invalid = Miles::tryMake(-4.5);
+	ASSERT_FALSE(invalid.ok());
+	ASSERT_STREQ(invalid.error(), "Miles cannot be negative");
+
+	ASSERT_FALSE(PassengerCount::tryMake(-1).ok());
+
+	const auto nan = Miles::tryMake(std::numeric_limits<double>::quiet_NaN());
+	ASSERT_FALSE(nan.ok());
+	ASSERT_STREQ(nan.error(), "Miles must be a finite number");
+
+	ASSERT_FALSE(Miles::tryMake(std::numeric_limits<double>::infinity()).ok());
+	ASSERT_FALSE(DollarsPerMile::tryMake(std::numeric_limits<double>::quiet_NaN()).ok());
+	ASSERT_FALSE(DollarsPerMile::tryMake(std::numeric_limits<double>::infinity()).ok());
+}
+
 TEST(TravelInstanceManager, Stats) {
 	const auto manager = TravelInstanceManager::instanceManager();
 
@@ -926,6 +950,18 @@ TEST(TravelInstanceManager, VehicleInstance) {
 
 	setVehicleAttributes(car, "-53.8", "-91", "-6");
 	verifyVehicleAttrValues(car, "49.352000", "58", "124");
+
+	setVehicleAttributes(car, "abc", "many", "");
+	verifyVehicleAttrValues(car, "49.352000", "58", "124");
+
+	setVehicleAttributes(car, "nan", "58", "inf");
+	verifyVehicleAttrValues(car, "49.352000", "58", "124");
+
+	setVehicleAttributes(car, "inf", "58", "nan");
+	verifyVehicleAttrValues(car, "49.352000", "58", "124");
+
+	setVehicleAttributes(car, "0x1p3", "58", "1e2");
+	verifyVehicleAttrValues(car, "49.352000", "58", "100");
 }
 
 void setSegmentAttributes(const Ptr<Instance>& instance,
@@ -977,9 +1013,129 @@ TEST(TravelInstanceManager, SegmentInstance) {
 	setSegmentAttributes(road, "airport-2", "residence-1", "-23");
 	verifySegmentAttrValues(road, "airport-2", "residence-1", "4.000000");
 
+	road->attributeIs("length", "nan");
+	road->attributeIs("length", "infinity");
+	verifySegmentAttrValues(road, "airport-2", "residence-1", "4.000000");
+
 	ASSERT_EQ(res1->attribute("segment1"), "");
 	ASSERT_EQ(air1->attribute("segment1"), "");
 	ASSERT_EQ(air2->attribute("segment1"), "flight");
 	ASSERT_EQ(air2->attribute("segment2"), "road");
 	ASSERT_EQ(air2->attribute("segment3"), "");
 }
+
+TEST(ValueTypes, layout) {
+	ASSERT_TRUE(sizeof(Miles) == sizeof(double));
+	ASSERT_TRUE(std::is_trivially_copyable<Miles>::value);
+
+	constexpr Miles length(10.0);
+	ASSERT_TRUE(length == Miles(10.00001));
+	ASSERT_TRUE(length != Miles(10.1));
+	ASSERT_THROW(Miles(-1.0), fwk::RangeException);
+}
+
+static U64 fakeLogNs = 0;
+
+static U64 fakeLogClock() {
+	return fakeLogNs;
+}
+
+TEST(CommonLib, logErrorRateLimit) {
+	auto& logger = fwk::Logger::instance();
+	ASSERT_EQ(logger.rateLimit(), 0u);
+
+	char path[] = "/tmp/travelsim-log-XXXXXX";
+	const int fd = mkstemp(path);
+	ASSERT_TRUE(fd >= 0);
+
+	logger.fdIs(fd);
+	logger.clockIs(&fakeLogClock);
+	logger.rateLimitIs(2);
+
+	// Five messages in one second and one in the next, from one call site.
+	for (auto i = 0; i < 6; ++i) {
+		fakeLogNs = i < 5 ? 7000000000ull : 8000000000ull;
+		logError(WARNING, "duplicate name");
+	}
+
+	logger.flush();
+	logger.fdIs(2);
+	logger.rateLimitIs(0);
+	logger.clockIs(null);
+
+	std::ifstream log(path);
+	std::stringstream contents;
+	contents << log.rdbuf();
+	close(fd);
+	unlink(path);
+
+	ASSERT_EQ(contents.str(),
+		"[WARNING]: duplicate name\n"
+		"[WARNING]: duplicate name\n"
+		"[WARNING]: 3 similar messages suppressed\n"
+		"[WARNING]: duplicate name\n"
+	);
+}
+
+TEST(Time, rounding) {
+	ASSERT_EQ(fwk::Time(1.5).ticks(), 1500000000);
+	ASSERT_EQ(fwk::Time(1e-9).ticks(), 1);
+	ASSERT_EQ(fwk::Time(0.4e-9).ticks(), 0);
+	ASSERT_EQ(fwk::Time(0.6e-9).ticks(), 1);
+	ASSERT_EQ(fwk::Time(-0.6e-9).ticks(), -1);
+	ASSERT_EQ(fwk::Time(-2.25).ticks(), -2250000000);
+	ASSERT_TRUE(fwk::Time(-2.25) < fwk::Time(0.0));
+	ASSERT_TRUE(fwk::Time(0.1) + fwk::Time(0.2) == fwk::Time(0.3));
+	ASSERT_TRUE(fwk::Time(1.0) - fwk::Time(3.0) == fwk::Time(-2.0));
+}
+
+TEST(Time, ticksRoundTrip) {
+	const S64 ticks[] = { 0, 1, -1, 999999999, -1500000000, 86400000000000 };
+	for (const auto t : ticks) {
+		const auto time = fwk::Time::fromTicks(t);
+		ASSERT_EQ(time.ticks(), t);
+		ASSERT_EQ(fwk::Time(time.value()).ticks(), t);
+	}
+}
+
+TEST(Time, range) {
+	const auto last = fwk::Time::fromTicks(INT64_MAX);
+	const auto first = fwk::Time::fromTicks(INT64_MIN);
+	ASSERT_TRUE(fwk::Time(1e12) == last);
+	ASSERT_TRUE(fwk::Time(std::numeric_limits<double>::infinity()) == last);
+	ASSERT_TRUE(fwk::Time(-1e12) == first);
+	ASSERT_TRUE(fwk::Time(-std::numeric_limits<double>::infinity()) == first);
+	ASSERT_THROW(fwk::Time(std::numeric_limits<double>::quiet_NaN()),
+		fwk::RangeException);
+}
+
+class TimeOrderReactor : public fwk::Activity::Notifiee {
+};
+
+TEST(SequentialManager, sameTickOrder) {
+	const auto manager = fwk::SequentialManager::instance();
+	const auto start = manager->now();
+	const Ptr<TimeOrderReactor> reactor = new TimeOrderReactor();
+
+	// Names are out of order, and c and d are added with the same time
+	// as a and b, so only their time and insertion order can decide.
+	string order;
+	const char* const names[] = { "d", "b", "c", "a" };
+	const double offsets[] = { 1.0, 2.0, 1.0, 0.5 };
+	for (auto i = 0; i < 4; ++i) {
+		const auto name = string(names[i]);
+		const auto activity = manager->activityNew("sameTickOrder-" + name);
+		activity->nextTimeIs(start + offsets[i]);
+		activity->postingNew(reactor, [&order, name]() { order += name; });
+	}
+
+	manager->nowIs(start + 0.75);
+	ASSERT_EQ(order, "a");
+	manager->nowIs(start + 3.0);
+	ASSERT_EQ(order, "adcb");
+	ASSERT_TRUE(manager->now() == start + 3.0);
+
+	for (const auto name : names) {
+		manager->activityDel("sameTickOrder-" + string(name));
+	}
+}